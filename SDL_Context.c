@@ -17,12 +17,12 @@
  * 7.  optimize raster algorithms                 [ ]
  * 8.  support other image formats                [ ]
  * 9.  add scale by X and Y axis                  [x]
- * 10. add buffering modes                        [-]
+ * 10. add buffering modes                        [x]
  * 11. make safe exit on panic                    [ ]
  * 12. refactor project!                          [ ]
  * 13. add joystick support                       [ ]
  * 14. fix SDL_ContextBitmapCopy                  [ ]
- * 15. add way to determine bitmap overlapping    [ ]
+ * 15. add way to determine bitmap overlapping    [x]
  */
 
 // TODO: do not PANIC() if asset load failed 
@@ -35,6 +35,7 @@
 #include <stdbool.h>
 #include <math.h>
 #include <stdlib.h>
+#include <limits.h>
 
 #define ALLOCATION_STEP (32)
 
@@ -57,6 +58,8 @@
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 #define CLAMP(x, a, b) ((x) < (a) ? (a) : (x) > (b) ? (b) : (x))
+// pixels from a row to the next one, rows may be padded
+#define STRIDE(bmp) ((bmp)->pitch / (int)sizeof(uint32_t))
 #define SWAP(a, b) \
 	do { \
 		register int __tmp = a; \
@@ -64,6 +67,92 @@
 		b = __tmp; \
 	} while (0)
 
+//
+// SIMD
+//
+
+#ifndef SDL_CONTEXT_NO_SIMD
+#if defined(__AVX2__)
+#include <immintrin.h>
+typedef __m256i simd_t;
+#define SIMD_PIXELS (8)
+#define SIMD_LOAD(p) _mm256_loadu_si256((const __m256i*)(p))
+#define SIMD_STORE(p, v) _mm256_storeu_si256((__m256i*)(p), (v))
+#define SIMD_ZERO() _mm256_setzero_si256()
+#define SIMD_SET16(x) _mm256_set1_epi16((short)(x))
+#define SIMD_SET8(x) _mm256_set1_epi8((char)(x))
+#define SIMD_SET32(x) _mm256_set1_epi32((int)(x))
+#define SIMD_AND(a, b) _mm256_and_si256((a), (b))
+#define SIMD_OR(a, b) _mm256_or_si256((a), (b))
+#define SIMD_ANDNOT(a, b) _mm256_andnot_si256((a), (b))
+#define SIMD_ADD16(a, b) _mm256_add_epi16((a), (b))
+#define SIMD_SUB16(a, b) _mm256_sub_epi16((a), (b))
+#define SIMD_MUL16(a, b) _mm256_mullo_epi16((a), (b))
+#define SIMD_SRL16(a, n) _mm256_srli_epi16((a), (n))
+#define SIMD_SLL64(a, n) _mm256_sll_epi64((a), _mm_cvtsi32_si128(n))
+#define SIMD_SRL64(a, n) _mm256_srl_epi64((a), _mm_cvtsi32_si128(n))
+#define SIMD_TESTZ(a) _mm256_testz_si256((a), (a))
+#define SIMD_SLL32(a, n) _mm256_sll_epi32((a), _mm_cvtsi32_si128(n))
+#define SIMD_SRL32(a, n) _mm256_srl_epi32((a), _mm_cvtsi32_si128(n))
+// pixels 0..3 and 4..7 each doubled
+#define SIMD_DUP32LO(a) _mm256_permute2x128_si256(_mm256_unpacklo_epi32((a), (a)), _mm256_unpackhi_epi32((a), (a)), 0x20)
+#define SIMD_DUP32HI(a) _mm256_permute2x128_si256(_mm256_unpacklo_epi32((a), (a)), _mm256_unpackhi_epi32((a), (a)), 0x31)
+#define SIMD_CMPEQ8(a, b) _mm256_cmpeq_epi8((a), (b))
+#define SIMD_CMPEQ32(a, b) _mm256_cmpeq_epi32((a), (b))
+#define SIMD_UNPACKLO8(a, b) _mm256_unpacklo_epi8((a), (b))
+#define SIMD_UNPACKHI8(a, b) _mm256_unpackhi_epi8((a), (b))
+#define SIMD_PACK16(a, b) _mm256_packus_epi16((a), (b))
+#define SIMD_BROADCAST_A16(a) _mm256_shufflehi_epi16(_mm256_shufflelo_epi16((a), 0), 0)
+#define SIMD_STREAM(p, v) _mm256_stream_si256((__m256i*)(p), (v))
+#define SIMD_FENCE() _mm_sfence()
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+typedef __m128i simd_t;
+#define SIMD_PIXELS (4)
+#define SIMD_LOAD(p) _mm_loadu_si128((const __m128i*)(p))
+#define SIMD_STORE(p, v) _mm_storeu_si128((__m128i*)(p), (v))
+#define SIMD_ZERO() _mm_setzero_si128()
+#define SIMD_SET16(x) _mm_set1_epi16((short)(x))
+#define SIMD_SET8(x) _mm_set1_epi8((char)(x))
+#define SIMD_SET32(x) _mm_set1_epi32((int)(x))
+#define SIMD_AND(a, b) _mm_and_si128((a), (b))
+#define SIMD_OR(a, b) _mm_or_si128((a), (b))
+#define SIMD_ANDNOT(a, b) _mm_andnot_si128((a), (b))
+#define SIMD_ADD16(a, b) _mm_add_epi16((a), (b))
+#define SIMD_SUB16(a, b) _mm_sub_epi16((a), (b))
+#define SIMD_MUL16(a, b) _mm_mullo_epi16((a), (b))
+#define SIMD_SRL16(a, n) _mm_srli_epi16((a), (n))
+#define SIMD_SLL64(a, n) _mm_sll_epi64((a), _mm_cvtsi32_si128(n))
+#define SIMD_SRL64(a, n) _mm_srl_epi64((a), _mm_cvtsi32_si128(n))
+#define SIMD_TESTZ(a) (_mm_movemask_epi8(_mm_cmpeq_epi8((a), _mm_setzero_si128())) == 0xFFFF)
+#define SIMD_SLL32(a, n) _mm_sll_epi32((a), _mm_cvtsi32_si128(n))
+#define SIMD_SRL32(a, n) _mm_srl_epi32((a), _mm_cvtsi32_si128(n))
+#define SIMD_DUP32LO(a) _mm_unpacklo_epi32((a), (a))
+#define SIMD_DUP32HI(a) _mm_unpackhi_epi32((a), (a))
+#define SIMD_CMPEQ8(a, b) _mm_cmpeq_epi8((a), (b))
+#define SIMD_CMPEQ32(a, b) _mm_cmpeq_epi32((a), (b))
+#define SIMD_UNPACKLO8(a, b) _mm_unpacklo_epi8((a), (b))
+#define SIMD_UNPACKHI8(a, b) _mm_unpackhi_epi8((a), (b))
+#define SIMD_PACK16(a, b) _mm_packus_epi16((a), (b))
+#define SIMD_BROADCAST_A16(a) _mm_shufflehi_epi16(_mm_shufflelo_epi16((a), 0), 0)
+#define SIMD_STREAM(p, v) _mm_stream_si128((__m128i*)(p), (v))
+#define SIMD_FENCE() _mm_sfence()
+#endif
+#endif // SDL_CONTEXT_NO_SIMD
+
+// blocks larger than this bypass the cache on clear (roughly LLC size)
+#ifndef SDL_CONTEXT_STREAM_BYTES
+#define SDL_CONTEXT_STREAM_BYTES (8 << 20)
+#endif
+
+// smallest number of pixels split into row bands among threads
+#ifndef SDL_CONTEXT_PARALLEL_PIXELS
+#define SDL_CONTEXT_PARALLEL_PIXELS (1 << 17)
+#endif
+
+// x / 255 with rounding for 16-bit lanes, x must already contain + 128
+#define SIMD_DIV255(x) SIMD_SRL16(SIMD_ADD16((x), SIMD_SRL16((x), 8)), 8)
+
 //
 // Default callbacks
 //
@@ -316,6 +405,22 @@ void SDL_ContextRenderLua(SDL_Context* ctx)
 
 #endif // SDL_CONTEXT_LUA
 
+//
+// Thread pool
+//
+
+#include "SDL_ContextThreads.c"
+
+#ifndef SDL_CONTEXT_NO_GRAPHICS
+
+//
+// Command buffer
+//
+
+#include "SDL_ContextCommands.c"
+
+#endif // SDL_CONTEXT_NO_GRAPHICS
+
 //
 // Core
 //
@@ -389,6 +494,10 @@ SDL_Context* SDL_CreateContext(
 		fprintf(stdout, "SDL_Context(%s): Bitmap creation error!\n", __func__);
 	}
 
+	// only written areas are presented, first frame is presented whole
+	SDL_ContextBitmapTrackDirty(ctx->bitmap, true);
+	SDL_ContextBitmapMarkDirty(ctx->bitmap, 0, 0, w_width, w_height);
+
 #ifdef SDL_CONTEXT_RENDER_SOFTWARE
 
 	//
@@ -523,7 +632,8 @@ void SDL_ContextMainLoop(SDL_Context* const restrict ctx, unsigned short frameCa
 			}
 		}
 #ifdef SDL_CONTEXT_RENDER_SOFTWARE
-		SDL_UpdateWindowSurface(ctx->window);
+		// double buffered frames are shown by next SDL_ContextSwapBuffers
+		if (!ctx->presenter) SDL_UpdateWindowSurface(ctx->window);
 #else // SDL_CONTEXT_RENDER_SOFTWARE
 		SDL_RenderPresent(ctx->renderer);
 #endif // SDL_CONTEXT_RENDER_SOFTWARE
@@ -556,7 +666,8 @@ void SDL_ContextMainLoop(SDL_Context* ctx, unsigned short frameCap)
 		ctx->render(ctx);
 
 #ifdef SDL_CONTEXT_RENDER_SOFTWARE
-		SDL_UpdateWindowSurface(ctx->window);
+		// double buffered frames are shown by next SDL_ContextSwapBuffers
+		if (!ctx->presenter) SDL_UpdateWindowSurface(ctx->window);
 #else // SDL_CONTEXT_RENDER_SOFTWARE
 		SDL_RenderPresent(ctx->renderer);
 #endif // SDL_CONTEXT_RENDER_SOFTWARE
@@ -572,6 +683,16 @@ void SDL_DestroyContext(SDL_Context* ctx)
 {
 	if (!ctx) return;
 
+#ifdef SDL_CONTEXT_RENDER_SOFTWARE
+	// presenter thread scales into window surface, it is stopped first
+	if (ctx->presenter) SDL_ContextSetBuffering(ctx, SDL_CONTEXT_SINGLE_BUFFER);
+#endif // SDL_CONTEXT_RENDER_SOFTWARE
+
+#if !defined(SDL_CONTEXT_RENDER_SOFTWARE) && !defined(SDL_CONTEXT_NO_GRAPHICS)
+	// frame buffer gets its own pixels back while texture still exists
+	if (ctx->pixels) SDL_ContextSetBuffering(ctx, SDL_CONTEXT_SINGLE_BUFFER);
+#endif // SDL_CONTEXT_RENDER_SOFTWARE
+
 	if (ctx->window) SDL_DestroyWindow(ctx->window);
 
 #ifndef SDL_CONTEXT_RENDER_SOFTWARE
@@ -579,12 +700,16 @@ void SDL_DestroyContext(SDL_Context* ctx)
 	if (ctx->texture) SDL_DestroyTexture(ctx->texture);
 #else // SDL_CONTEXT_RENDER_SOFTWARE
 	if (ctx->surface) SDL_FreeSurface(ctx->surface);
+	xfree(ctx->expanded);
 #endif // SDL_CONTEXT_RENDER_SOFTWARE
 
 #ifndef SDL_CONTEXT_NO_GRAPHICS
 	if (ctx->bitmap) SDL_ContextDestroyBitmap(ctx->bitmap);
+	if (ctx->commands) destroyCommands(ctx->commands);
 #endif // SDL_CONTEXT_NO_GRAPHICS
 
+	SDL_ContextStopThreads();
+
 #ifndef SDL_CONTEXT_NO_AUDIO
 
 	if (ctx->audioEnabled)
@@ -605,21 +730,427 @@ void SDL_DestroyContext(SDL_Context* ctx)
 	xfree(ctx);
 }
 
+#ifdef SDL_CONTEXT_RENDER_SOFTWARE
+
+//
+// Software present
+//
+
+typedef struct
+{
+	const uint32_t* src;
+	int srcPitch;  // in pixels
+	uint8_t* dest;
+	int destPitch; // in bytes
+	int count, sx, sy, rot;
+}
+PresentRows;
+
+// Right rotation turning SDL_CONTEXT_PIXELFORMAT into format, -1 if it is
+// not a rotation of it (then SDL_BlitScaled converts)
+static int presentRotation(const SDL_PixelFormat* format)
+{
+	const int r = (24 - format->Rshift + 32) % 32;
+	if (format->BytesPerPixel != 4 || format->Rloss || format->Gloss || format->Bloss
+		|| format->Gshift != (16 - r + 32) % 32 || format->Bshift != (8 - r + 32) % 32
+		|| (format->Amask && format->Ashift != (32 - r) % 32))
+		return -1;
+	return r;
+}
+
+// n source pixels each written sx times
+static void scaleSpan(uint32_t* restrict d, const uint32_t* restrict s, int n, int sx, int rot)
+{
+	register int i = 0;
+	register uint32_t p;
+#ifdef SIMD_PIXELS
+	register simd_t v;
+	if (sx <= 2)
+		for (; i + SIMD_PIXELS <= n; i += SIMD_PIXELS, s += SIMD_PIXELS)
+		{
+			v = SIMD_LOAD(s);
+			if (rot) v = SIMD_OR(SIMD_SRL32(v, rot), SIMD_SLL32(v, 32 - rot));
+			if (sx == 1)
+				SIMD_STORE(d, v), d += SIMD_PIXELS;
+			else
+			{
+				SIMD_STORE(d, SIMD_DUP32LO(v));
+				SIMD_STORE(d + SIMD_PIXELS, SIMD_DUP32HI(v));
+				d += 2 * SIMD_PIXELS;
+			}
+		}
+	else if (sx >= SIMD_PIXELS)
+	{
+		// overlapping last store covers the rest of the run
+		for (; i < n; ++i, d += sx)
+		{
+			p = *s++;
+			v = SIMD_SET32(rot ? p >> rot | p << (32 - rot) : p);
+			for (register int k = 0; k < sx - SIMD_PIXELS; k += SIMD_PIXELS)
+				SIMD_STORE(d + k, v);
+			SIMD_STORE(d + sx - SIMD_PIXELS, v);
+		}
+		return;
+	}
+#endif
+	for (; i < n; ++i)
+	{
+		p = *s++;
+		p = rot ? p >> rot | p << (32 - rot) : p;
+		for (register int k = 0; k < sx; ++k)
+			*d++ = p;
+	}
+}
+
+static void presentRows(void* data, int y1, int y2)
+{
+	const PresentRows* const job = data;
+	register uint8_t* d;
+	for (; y1 < y2; ++y1)
+	{
+		d = job->dest + y1 * job->sy * job->destPitch;
+		scaleSpan((uint32_t*)d, job->src + y1 * job->srcPitch, job->count, job->sx, job->rot);
+		// other rows of the pixel are copies of the first one
+		for (register int k = 1; k < job->sy; ++k)
+			memcpy(d + k * job->destPitch, d, job->count * job->sx * sizeof(uint32_t));
+	}
+}
+
+// Scale rects of src into locked window surface
+static void presentFrame(SDL_Surface* restrict src, SDL_Surface* restrict wind, const SDL_Rect* rects, int count, int sx, int sy)
+{
+	const int rot = presentRotation(wind->format);
+	PresentRows job = { NULL, src->pitch / sizeof(uint32_t), NULL, wind->pitch, 0, sx, sy, rot };
+	SDL_Rect rect, scaled;
+	for (register int i = 0; i < count; ++i)
+	{
+		rect = rects[i];
+		scaled.x = rect.x * sx, scaled.y = rect.y * sy;
+		scaled.w = rect.w * sx, scaled.h = rect.h * sy;
+		if (rot < 0 || scaled.x + scaled.w > wind->w || scaled.y + scaled.h > wind->h)
+		{
+			SDL_BlitScaled(src, &rect, wind, &scaled);
+			continue;
+		}
+		// replicated straight into window surface
+		job.src = (const uint32_t*)src->pixels + rect.x + rect.y * job.srcPitch;
+		job.dest = (uint8_t*)wind->pixels + scaled.y * wind->pitch + scaled.x * sizeof(uint32_t);
+		job.count = rect.w;
+		SDL_ContextParallelRows(0, rect.h, scaled.w * sy, presentRows, &job);
+	}
+}
+
+//
+// Double buffering
+//
+
+// Frame N is scaled on presenter thread from front pixels while frame N + 1
+// is drawn into the frame buffer, and shown at the next swap.
+typedef struct SDL_ContextPresenter
+{
+	SDL_ContextBitmap* front; // pixels of presented frame
+	SDL_Surface* surface, *wind;
+	SDL_Thread* thread;
+	SDL_sem* start, *done;
+	SDL_Rect whole;
+	int sx, sy;
+	bool busy, quit;
+}
+SDL_ContextPresenter;
+
+static int presenterMain(void* data)
+{
+	SDL_ContextPresenter* const p = data;
+	for (;;)
+	{
+		SDL_SemWait(p->start);
+		if (p->quit)
+			break;
+		presentFrame(p->surface, p->wind, &p->whole, 1, p->sx, p->sy);
+		SDL_SemPost(p->done);
+	}
+	return 0;
+}
+
+// wait for frame being scaled and show it
+static void finishPresent(SDL_Context* restrict ctx)
+{
+	register SDL_ContextPresenter* const p = ctx->presenter;
+	if (!p->busy)
+		return;
+	SDL_SemWait(p->done);
+	if (SDL_MUSTLOCK(p->wind)) SDL_UnlockSurface(p->wind);
+	SDL_UpdateWindowSurface(ctx->window);
+	p->busy = false;
+}
+
+// scale front pixels on presenter thread
+static void startPresent(SDL_Context* restrict ctx)
+{
+	register SDL_ContextPresenter* const p = ctx->presenter;
+	ctx->surface->pixels = p->front->pixels;
+	p->wind = SDL_GetWindowSurface(ctx->window);
+	if (SDL_MUSTLOCK(p->wind)) SDL_LockSurface(p->wind);
+	p->busy = true;
+	SDL_SemPost(p->start);
+}
+
+// Drawn frame is presented whole. Other buffer holds the frame before it,
+// areas written since then are copied into it, so drawing goes on from the
+// presented frame.
+static void swapPresent(SDL_Context* restrict ctx)
+{
+	register SDL_ContextPresenter* const p = ctx->presenter;
+	register SDL_ContextBitmap* const bmp = ctx->bitmap;
+	register uint32_t* const pixels = bmp->pixels;
+	const SDL_Rect whole = { 0, 0, bmp->width, bmp->height };
+	register const SDL_Rect* r = bmp->dirty.track ? bmp->dirty.rects : &whole;
+	register const SDL_Rect* const end = r + (bmp->dirty.track ? bmp->dirty.count : 1);
+
+	finishPresent(ctx);
+	bmp->pixels = p->front->pixels, p->front->pixels = pixels;
+	startPresent(ctx);
+
+	// presenter only reads front pixels too
+	for (; r < end; ++r)
+		for (register int y = r->y; y < r->y + r->h; ++y)
+			memcpy(bmp->pixels + r->x + y * STRIDE(bmp), pixels + r->x + y * STRIDE(p->front), r->w * sizeof(uint32_t));
+	bmp->dirty.count = 0;
+}
+
+// Indexed frame is expanded outside of the frame buffer and presented whole:
+// into front pixels when double buffered, into own buffer otherwise
+static void presentIndexed(SDL_Context* restrict ctx)
+{
+	register SDL_ContextPresenter* const p = ctx->presenter;
+	register SDL_ContextBitmap* const bmp = ctx->bitmap;
+	register SDL_Surface* restrict wind;
+	const SDL_Rect whole = { 0, 0, bmp->width, bmp->height };
+
+	bmp->dirty.count = 0;
+	if (p)
+	{
+		finishPresent(ctx);
+		SDL_ContextIndexedExpand(ctx->indexed, p->front->pixels, p->front->pitch);
+		startPresent(ctx);
+		return;
+	}
+
+	if (!ctx->expanded)
+		ctx->expanded = xmalloc(bmp->height * ctx->surface->pitch);
+	SDL_ContextIndexedExpand(ctx->indexed, ctx->expanded, ctx->surface->pitch);
+	ctx->surface->pixels = ctx->expanded;
+	wind = SDL_GetWindowSurface(ctx->window);
+	if (SDL_MUSTLOCK(wind)) SDL_LockSurface(wind);
+	presentFrame(ctx->surface, wind, &whole, 1, ctx->scaleX, ctx->scaleY);
+	if (SDL_MUSTLOCK(wind)) SDL_UnlockSurface(wind);
+	ctx->surface->pixels = bmp->pixels;
+}
+
+#elif !defined(SDL_CONTEXT_NO_GRAPHICS)
+
+//
+// Streaming frame buffer
+//
+
+// frame buffer points into texture memory until next swap
+static bool lockFramebuffer(SDL_Context* restrict ctx)
+{
+	void* pixels;
+	int pitch;
+	if (SDL_LockTexture(ctx->texture, NULL, &pixels, &pitch))
+	{
+		fprintf(stdout, "SDL_Context(%s): Cannot lock texture: %s\n", __func__, SDL_GetError());
+		return false;
+	}
+	ctx->bitmap->pixels = pixels;
+	ctx->bitmap->pitch = pitch;
+	return true;
+}
+
+// frame buffer gets own pixels back, texture must be unlocked
+static void restoreFramebuffer(SDL_Context* restrict ctx)
+{
+	register SDL_ContextBitmap* const bmp = ctx->bitmap;
+	bmp->pixels = ctx->pixels;
+	bmp->pitch = bmp->width * sizeof(uint32_t);
+	ctx->pixels = NULL;
+}
+
+// locked texture memory is copied to own pixels before unlocking
+static void keepFramebuffer(SDL_Context* restrict ctx)
+{
+	register const SDL_ContextBitmap* const bmp = ctx->bitmap;
+	for (register int y = 0; y < bmp->height; ++y)
+		memcpy(ctx->pixels + y * bmp->width, (uint8_t*)bmp->pixels + y * bmp->pitch, bmp->width * sizeof(uint32_t));
+}
+
+// texture memory is gone after unlocking, presented frame is read back and
+// sampled to frame size instead, it is drawn whole if even that fails
+static void readbackFramebuffer(SDL_Context* restrict ctx)
+{
+	register SDL_ContextBitmap* const bmp = ctx->bitmap;
+	int w, h;
+	uint32_t* out = NULL;
+	if (!SDL_GetRendererOutputSize(ctx->renderer, &w, &h) && w > 0 && h > 0
+		&& (out = xmalloc(sizeof(uint32_t) * w * h))
+		&& !SDL_RenderReadPixels(ctx->renderer, NULL, SDL_CONTEXT_PIXELFORMAT, out, w * sizeof(uint32_t)))
+	{
+		for (register int y = 0; y < bmp->height; ++y)
+		{
+			register const uint32_t* const row = out + (long long)(2 * y + 1) * h / (2 * bmp->height) * w;
+			for (register int x = 0; x < bmp->width; ++x)
+				bmp->pixels[x + y * STRIDE(bmp)] = row[(long long)(2 * x + 1) * w / (2 * bmp->width)];
+		}
+	}
+	else
+	{
+		fprintf(stdout, "SDL_Context(%s): Cannot read frame back: %s\n", __func__, SDL_GetError());
+		SDL_ContextBitmapMarkDirty(bmp, 0, 0, bmp->width, bmp->height);
+	}
+	xfree(out);
+}
+
+#endif // SDL_CONTEXT_RENDER_SOFTWARE
+
+void SDL_ContextSetBuffering(SDL_Context* ctx, SDL_ContextBuffering mode)
+{
+#ifdef SDL_CONTEXT_RENDER_SOFTWARE
+	register SDL_ContextPresenter* p = ctx->presenter;
+	if (mode == SDL_CONTEXT_STREAMING_BUFFER)
+	{
+		fprintf(stdout, "SDL_Context(%s): Streaming frame buffer is for accelerated rendering only!\n", __func__);
+		return;
+	}
+	if ((mode == SDL_CONTEXT_DOUBLE_BUFFER) == (p != NULL))
+		return;
+
+	if (!p)
+	{
+		p = xcalloc(1, sizeof(SDL_ContextPresenter));
+		p->front = SDL_ContextCreateBitmap(ctx->bitmap->width, ctx->bitmap->height);
+		// both buffers start with the frame drawn so far
+		memcpy(p->front->pixels, ctx->bitmap->pixels, ctx->bitmap->height * ctx->bitmap->pitch);
+		p->surface = ctx->surface;
+		p->sx = ctx->scaleX, p->sy = ctx->scaleY;
+		p->whole.w = ctx->bitmap->width, p->whole.h = ctx->bitmap->height;
+		if ((p->start = SDL_CreateSemaphore(0)) && (p->done = SDL_CreateSemaphore(0))
+			&& (p->thread = SDL_CreateThread(presenterMain, "SDL_ContextPresenter", p)))
+		{
+			ctx->presenter = p;
+			return;
+		}
+		fprintf(stdout, "SDL_Context(%s): Cannot create presenter: %s\n", __func__, SDL_GetError());
+	}
+	else
+	{
+		finishPresent(ctx);
+		p->quit = true;
+		SDL_SemPost(p->start);
+		SDL_WaitThread(p->thread, NULL);
+
+		// frame buffer is presented by itself again, whole
+		ctx->surface->pixels = ctx->bitmap->pixels;
+		SDL_ContextBitmapMarkDirty(ctx->bitmap, 0, 0, ctx->bitmap->width, ctx->bitmap->height);
+		ctx->presenter = NULL;
+	}
+
+	if (p->start) SDL_DestroySemaphore(p->start);
+	if (p->done) SDL_DestroySemaphore(p->done);
+	SDL_ContextDestroyBitmap(p->front);
+	xfree(p);
+#elif !defined(SDL_CONTEXT_NO_GRAPHICS)
+	register uint32_t* const pixels = ctx->bitmap ? ctx->bitmap->pixels : NULL;
+	if (mode == SDL_CONTEXT_DOUBLE_BUFFER)
+	{
+		fprintf(stdout, "SDL_Context(%s): Double buffering is for software rendering only!\n", __func__);
+		return;
+	}
+	if ((mode == SDL_CONTEXT_STREAMING_BUFFER) == (ctx->pixels != NULL) || !pixels)
+		return;
+
+	if (ctx->pixels)
+	{
+		// frame drawn so far is uploaded and kept
+		keepFramebuffer(ctx);
+		SDL_UnlockTexture(ctx->texture);
+		restoreFramebuffer(ctx);
+	}
+	else if (lockFramebuffer(ctx))
+		ctx->pixels = pixels;
+#else // SDL_CONTEXT_RENDER_SOFTWARE
+	(void)ctx, (void)mode;
+#endif // SDL_CONTEXT_RENDER_SOFTWARE
+}
+
 void SDL_ContextSwapBuffers(SDL_Context* restrict ctx)
 {
+#ifndef SDL_CONTEXT_NO_GRAPHICS
+	if (ctx->commands) endCommandFrame(ctx);
+#endif // SDL_CONTEXT_NO_GRAPHICS
 #ifndef SDL_CONTEXT_RENDER_SOFTWARE
 #ifndef SDL_CONTEXT_NO_GRAPHICS
-	SDL_UpdateTexture(ctx->texture, NULL, ctx->bitmap->pixels, ctx->bitmap->pitch);
+	register SDL_ContextBitmap* const bmp = ctx->bitmap;
+	void* pixels;
+	int pitch;
+	if (ctx->pixels)
+	{
+		// frame is in texture memory already, unlocking uploads it
+		if (ctx->indexed)
+			SDL_ContextIndexedExpand(ctx->indexed, bmp->pixels, bmp->pitch);
+		SDL_UnlockTexture(ctx->texture);
+	}
+	else if (ctx->indexed)
+	{
+		// palette is applied while uploading whole frame
+		if (!SDL_LockTexture(ctx->texture, NULL, &pixels, &pitch))
+		{
+			SDL_ContextIndexedExpand(ctx->indexed, pixels, pitch);
+			SDL_UnlockTexture(ctx->texture);
+		}
+	}
+	else if (!bmp->dirty.track)
+		SDL_UpdateTexture(ctx->texture, NULL, bmp->pixels, bmp->pitch);
+	else
+		for (register const SDL_Rect* r = bmp->dirty.rects; r < bmp->dirty.rects + bmp->dirty.count; ++r)
+			SDL_UpdateTexture(ctx->texture, r, bmp->pixels + r->x + r->y * STRIDE(bmp), bmp->pitch);
+	bmp->dirty.count = 0;
 #else // SDL_CONTEXT_NO_GRAPHICS
 	SDL_SetRenderTarget(ctx->renderer, NULL);
 #endif // SDL_CONTEXT_NO_GRAPHICS
 	SDL_RenderCopy(ctx->renderer, ctx->texture, NULL, NULL);
+#ifndef SDL_CONTEXT_NO_GRAPHICS
+	if (ctx->pixels && !lockFramebuffer(ctx))
+	{
+		restoreFramebuffer(ctx);
+		readbackFramebuffer(ctx);
+	}
+#endif // SDL_CONTEXT_NO_GRAPHICS
 #else // SDL_CONTEXT_RENDER_SOFTWARE
-	memcpy(ctx->surface->pixels, ctx->bitmap->pixels, ctx->bitmap->pitch * ctx->bitmap->height);
-	register SDL_Surface* restrict wind = SDL_GetWindowSurface(ctx->window);
+	register SDL_ContextBitmap* const bmp = ctx->bitmap;
+	register SDL_Surface* restrict wind;
+	const SDL_Rect whole = { 0, 0, bmp->width, bmp->height };
+	if (ctx->indexed)
+	{
+		presentIndexed(ctx);
+		return;
+	}
+	if (ctx->presenter)
+	{
+		swapPresent(ctx);
+		return;
+	}
+
+	// surface shares pixels with the frame buffer, nothing is copied
+	wind = SDL_GetWindowSurface(ctx->window);
 	if (SDL_MUSTLOCK(wind)) SDL_LockSurface(wind);
-	SDL_BlitScaled(ctx->surface, NULL, wind, NULL);
+	// written areas are known only while they are tracked
+	if (bmp->dirty.track)
+		presentFrame(ctx->surface, wind, bmp->dirty.rects, bmp->dirty.count, ctx->scaleX, ctx->scaleY);
+	else
+		presentFrame(ctx->surface, wind, &whole, 1, ctx->scaleX, ctx->scaleY);
 	if (SDL_MUSTLOCK(wind)) SDL_UnlockSurface(wind);
+	bmp->dirty.count = 0;
 #endif // SDL_CONTEXT_RENDER_SOFTWARE
 }
 
@@ -745,36 +1276,336 @@ FUNCTION_TYPE int SDL_ContextGetMouseY(const SDL_Context* ctx)
 // Graphics
 //
 
+//
+// Blend kernels
+//
+
+// Note: SDL_BLENDMODE_BLEND works in 8-bit fixed point with rounding, so
+// channels (before ANDing with mask) may differ by 1 from old float math.
+// Scalar and SIMD paths use the same formula and give identical results.
+
+static inline uint32_t div255(uint32_t x)
+{
+	x += 128;
+	return (x + (x >> 8)) >> 8;
+}
+
+static inline uint32_t blendPixelNone(uint32_t src, uint32_t dest, uint32_t mask)
+{
+	(void) dest;
+	(void) mask;
+	return src;
+}
+
+static inline uint32_t blendPixelBlend(uint32_t src, uint32_t dest, uint32_t mask)
+{
+	register const uint32_t a = div255(SDL_ContextColorA(src) * SDL_ContextColorA(mask)), c = 255 - a;
+	return SDL_ContextColor(
+		div255(SDL_ContextColorR(src) * a + SDL_ContextColorR(dest) * c),
+		div255(SDL_ContextColorG(src) * a + SDL_ContextColorG(dest) * c),
+		div255(SDL_ContextColorB(src) * a + SDL_ContextColorB(dest) * c),
+		a) & mask;
+}
+
+static inline uint32_t blendPixelMask(uint32_t src, uint32_t dest, uint32_t mask)
+{
+	return src & 0xFF ? (src & mask) | 0xFF : dest;
+}
+
+// src + dest * (1 - a) for source with color already multiplied by alpha,
+// mask alpha scales whole source, sums of malformed pixels saturate
+static inline uint32_t blendPixelPremul(uint32_t src, uint32_t dest, uint32_t mask)
+{
+	register const uint32_t ma = SDL_ContextColorA(mask), a = div255(SDL_ContextColorA(src) * ma), c = 255 - a;
+	return SDL_ContextColor(
+		MIN(div255(SDL_ContextColorR(src) * ma) + div255(SDL_ContextColorR(dest) * c), 255),
+		MIN(div255(SDL_ContextColorG(src) * ma) + div255(SDL_ContextColorG(dest) * c), 255),
+		MIN(div255(SDL_ContextColorB(src) * ma) + div255(SDL_ContextColorB(dest) * c), 255),
+		MIN(a + div255(SDL_ContextColorA(dest) * c), 255)) & mask;
+}
+
+// color channels multiplied by alpha, alpha is kept
+static inline uint32_t premultiplyPixel(uint32_t p)
+{
+	register const uint32_t a = SDL_ContextColorA(p);
+	return SDL_ContextColor(div255(SDL_ContextColorR(p) * a), div255(SDL_ContextColorG(p) * a), div255(SDL_ContextColorB(p) * a), a);
+}
+
+// Expands LOOP(None), LOOP(Blend) or LOOP(Mask) depending on blend mode, so
+// specialized loop bodies are selected once per primitive, not per pixel.
+#define BLEND_DISPATCH(mode, LOOP) \
+	do { \
+		switch (mode) \
+		{ \
+			case SDL_BLENDMODE_MASK: LOOP(Mask); break; \
+			case SDL_BLENDMODE_BLEND: LOOP(Blend); break; \
+			case SDL_BLENDMODE_NONE: \
+			default: LOOP(None); break; \
+		} \
+	} while (0)
+
+// BLEND_DISPATCH for drawing src into dest, blending of premultiplied source
+// expands LOOP(Premul)
+#define COPY_DISPATCH(dest, src, LOOP) \
+	do { \
+		if ((dest)->blendMode == SDL_BLENDMODE_BLEND && (src)->premultiplied) \
+		{ \
+			LOOP(Premul); \
+		} \
+		else \
+			BLEND_DISPATCH((dest)->blendMode, LOOP); \
+	} while (0)
+
 static inline void blendPixel(const SDL_ContextBitmap* restrict bmp, uint32_t* restrict dest, uint32_t src)
 {
-	switch (bmp->blendMode)
+#define BLEND_PIXEL(mode) *dest = blendPixel##mode(src, *dest, bmp->mask)
+	BLEND_DISPATCH(bmp->blendMode, BLEND_PIXEL);
+#undef BLEND_PIXEL
+}
+
+#ifdef SIMD_PIXELS
+
+// blend SIMD_PIXELS source pixels over destination pixels
+static inline simd_t simdBlendAlpha(simd_t s, simd_t d, simd_t ma, simd_t mask)
+{
+	const simd_t zero = SIMD_ZERO(), c255 = SIMD_SET16(255), c128 = SIMD_SET16(128);
+	simd_t slo = SIMD_UNPACKLO8(s, zero), shi = SIMD_UNPACKHI8(s, zero);
+	simd_t dlo = SIMD_UNPACKLO8(d, zero), dhi = SIMD_UNPACKHI8(d, zero);
+	simd_t alo = SIMD_BROADCAST_A16(slo), ahi = SIMD_BROADCAST_A16(shi);
+	alo = SIMD_DIV255(SIMD_ADD16(SIMD_MUL16(alo, ma), c128));
+	ahi = SIMD_DIV255(SIMD_ADD16(SIMD_MUL16(ahi, ma), c128));
+	slo = SIMD_ADD16(SIMD_ADD16(SIMD_MUL16(slo, alo), SIMD_MUL16(dlo, SIMD_SUB16(c255, alo))), c128);
+	shi = SIMD_ADD16(SIMD_ADD16(SIMD_MUL16(shi, ahi), SIMD_MUL16(dhi, SIMD_SUB16(c255, ahi))), c128);
+	s = SIMD_PACK16(SIMD_DIV255(slo), SIMD_DIV255(shi));
+	s = SIMD_OR(SIMD_AND(s, SIMD_SET32(0xFFFFFF00)), SIMD_AND(SIMD_PACK16(alo, ahi), SIMD_SET32(0xFF)));
+	return SIMD_AND(s, mask);
+}
+
+// blend constant color over destination pixels, sterm = src * a + 128
+static inline simd_t simdBlendAlphaConst(simd_t d, simd_t sterm, simd_t c, simd_t a, simd_t mask)
+{
+	const simd_t zero = SIMD_ZERO();
+	simd_t dlo = SIMD_UNPACKLO8(d, zero), dhi = SIMD_UNPACKHI8(d, zero);
+	dlo = SIMD_DIV255(SIMD_ADD16(SIMD_MUL16(dlo, c), sterm));
+	dhi = SIMD_DIV255(SIMD_ADD16(SIMD_MUL16(dhi, c), sterm));
+	return SIMD_AND(SIMD_OR(SIMD_AND(SIMD_PACK16(dlo, dhi), SIMD_SET32(0xFFFFFF00)), a), mask);
+}
+
+// premultiplied source over destination pixels, ma = mask alpha
+static inline simd_t simdBlendPremul(simd_t s, simd_t d, simd_t ma, simd_t mask)
+{
+	const simd_t zero = SIMD_ZERO(), c255 = SIMD_SET16(255), c128 = SIMD_SET16(128);
+	simd_t slo = SIMD_UNPACKLO8(s, zero), shi = SIMD_UNPACKHI8(s, zero);
+	simd_t dlo = SIMD_UNPACKLO8(d, zero), dhi = SIMD_UNPACKHI8(d, zero);
+	slo = SIMD_DIV255(SIMD_ADD16(SIMD_MUL16(slo, ma), c128));
+	shi = SIMD_DIV255(SIMD_ADD16(SIMD_MUL16(shi, ma), c128));
+	dlo = SIMD_DIV255(SIMD_ADD16(SIMD_MUL16(dlo, SIMD_SUB16(c255, SIMD_BROADCAST_A16(slo))), c128));
+	dhi = SIMD_DIV255(SIMD_ADD16(SIMD_MUL16(dhi, SIMD_SUB16(c255, SIMD_BROADCAST_A16(shi))), c128));
+	return SIMD_AND(SIMD_PACK16(SIMD_ADD16(slo, dlo), SIMD_ADD16(shi, dhi)), mask);
+}
+
+static inline simd_t simdPremultiply(simd_t p)
+{
+	const simd_t zero = SIMD_ZERO(), c128 = SIMD_SET16(128);
+	simd_t lo = SIMD_UNPACKLO8(p, zero), hi = SIMD_UNPACKHI8(p, zero);
+	lo = SIMD_DIV255(SIMD_ADD16(SIMD_MUL16(lo, SIMD_BROADCAST_A16(lo)), c128));
+	hi = SIMD_DIV255(SIMD_ADD16(SIMD_MUL16(hi, SIMD_BROADCAST_A16(hi)), c128));
+	return SIMD_OR(SIMD_AND(SIMD_PACK16(lo, hi), SIMD_SET32(0xFFFFFF00)), SIMD_AND(p, SIMD_SET32(0xFF)));
+}
+
+static inline simd_t simdBlendMask(simd_t s, simd_t d, simd_t mask)
+{
+	const simd_t transparent = SIMD_CMPEQ32(SIMD_AND(s, SIMD_SET32(0xFF)), SIMD_ZERO());
+	s = SIMD_OR(SIMD_AND(s, mask), SIMD_SET32(0xFF));
+	return SIMD_OR(SIMD_AND(transparent, d), SIMD_ANDNOT(transparent, s));
+}
+
+#endif // SIMD_PIXELS
+
+//
+// Span kernels, n pixels in a row
+//
+
+static inline void fillSpanNone(uint32_t* restrict dest, int n, uint32_t val, uint32_t mask)
+{
+	(void) mask;
+#ifdef SIMD_PIXELS
+	const simd_t v = SIMD_SET32(val);
+	for (; n >= SIMD_PIXELS; n -= SIMD_PIXELS, dest += SIMD_PIXELS)
+		SIMD_STORE(dest, v);
+#endif // SIMD_PIXELS
+	while (n-- > 0) *dest++ = val;
+}
+
+// fill n contiguous pixels, parts of huge blocks are streamed with non-temporal stores
+static void fillBlock(uint32_t* restrict dest, int n, uint32_t val, bool stream)
+{
+	if (val == (val & 0xFF) * 0x01010101u)
 	{
-		case SDL_BLENDMODE_MASK:
-			if (src & 0xFF)
-				*dest = SDL_ContextColor(
-				 	SDL_ContextColorR(src) & SDL_ContextColorR(bmp->mask),
-					SDL_ContextColorG(src) & SDL_ContextColorG(bmp->mask),
-					SDL_ContextColorB(src) & SDL_ContextColorB(bmp->mask),
-					0xFF);
-			break;
-		case SDL_BLENDMODE_BLEND:
-			{
-			register const float a = (float)(SDL_ContextColorA(src)) / 255.f * (float)(bmp->mask & 0xFF) / 255.f;
-			register const float c = 1.f - a;
-			src = SDL_ContextColor(
-				(uint8_t)(a * (float)SDL_ContextColorR(src) + c * (float)SDL_ContextColorR(*dest)),
-				(uint8_t)(a * (float)SDL_ContextColorG(src) + c * (float)SDL_ContextColorG(*dest)),
-				(uint8_t)(a * (float)SDL_ContextColorB(src) + c * (float)SDL_ContextColorB(*dest)),
-				(uint8_t)(a * 255.f));
-			src = ((src & 0xFF) & (bmp->mask & 0xFF)) | ((src & 0xFF00) & (bmp->mask & 0xFF00)) | ((src & 0xFF0000) & (bmp->mask & 0xFF0000)) | ((src & 0xFF000000) & (bmp->mask & 0xFF000000));
-			*dest = src;
-			}
-			break;
-		case SDL_BLENDMODE_NONE:
-		default:
-			*dest = src;
+		memset(dest, val & 0xFF, n * sizeof(uint32_t));
+		return;
+	}
+#ifdef SIMD_PIXELS
+	if (stream)
+	{
+		const simd_t v = SIMD_SET32(val);
+		for (; n > 0 && ((uintptr_t)dest & (sizeof(simd_t) - 1)); --n)
+			*dest++ = val;
+		for (; n >= SIMD_PIXELS; n -= SIMD_PIXELS, dest += SIMD_PIXELS)
+			SIMD_STREAM(dest, v);
+		SIMD_FENCE();
+	}
+#else // SIMD_PIXELS
+	(void)stream;
+#endif // SIMD_PIXELS
+	fillSpanNone(dest, n, val, 0);
+}
+
+static void fillSpanBlend(uint32_t* restrict dest, int n, uint32_t val, uint32_t mask)
+{
+	register const uint32_t a = div255(SDL_ContextColorA(val) * SDL_ContextColorA(mask));
+	if (a == 0xFF)
+	{
+		fillSpanNone(dest, n, (val | 0xFF) & mask, mask);
+		return;
+	}
+#ifdef SIMD_PIXELS
+	const simd_t vsterm = SIMD_ADD16(SIMD_MUL16(SIMD_UNPACKLO8(SIMD_SET32(val), SIMD_ZERO()), SIMD_SET16(a)), SIMD_SET16(128));
+	const simd_t vc = SIMD_SET16(255 - a), va = SIMD_SET32(a), vmask = SIMD_SET32(mask);
+	for (; n >= SIMD_PIXELS; n -= SIMD_PIXELS, dest += SIMD_PIXELS)
+		SIMD_STORE(dest, simdBlendAlphaConst(SIMD_LOAD(dest), vsterm, vc, va, vmask));
+#endif // SIMD_PIXELS
+	for (; n > 0; --n, ++dest)
+		*dest = blendPixelBlend(val, *dest, mask);
+}
+
+static inline void fillSpanMask(uint32_t* restrict dest, int n, uint32_t val, uint32_t mask)
+{
+	if (val & 0xFF) fillSpanNone(dest, n, (val & mask) | 0xFF, mask);
+}
+
+static inline void copySpanNone(uint32_t* restrict dest, const uint32_t* restrict src, int n, uint32_t mask)
+{
+	(void) mask;
+	memcpy(dest, src, n * sizeof(uint32_t));
+}
+
+static void copySpanBlend(uint32_t* restrict dest, const uint32_t* restrict src, int n, uint32_t mask)
+{
+#ifdef SIMD_PIXELS
+	const simd_t ma = SIMD_SET16(SDL_ContextColorA(mask)), vmask = SIMD_SET32(mask);
+	for (; n >= SIMD_PIXELS; n -= SIMD_PIXELS, dest += SIMD_PIXELS, src += SIMD_PIXELS)
+		SIMD_STORE(dest, simdBlendAlpha(SIMD_LOAD(src), SIMD_LOAD(dest), ma, vmask));
+#endif // SIMD_PIXELS
+	for (; n > 0; --n, ++dest, ++src)
+		*dest = blendPixelBlend(*src, *dest, mask);
+}
+
+static void copySpanPremul(uint32_t* restrict dest, const uint32_t* restrict src, int n, uint32_t mask)
+{
+#ifdef SIMD_PIXELS
+	const simd_t ma = SIMD_SET16(SDL_ContextColorA(mask)), vmask = SIMD_SET32(mask);
+	for (; n >= SIMD_PIXELS; n -= SIMD_PIXELS, dest += SIMD_PIXELS, src += SIMD_PIXELS)
+		SIMD_STORE(dest, simdBlendPremul(SIMD_LOAD(src), SIMD_LOAD(dest), ma, vmask));
+#endif // SIMD_PIXELS
+	for (; n > 0; --n, ++dest, ++src)
+		*dest = blendPixelPremul(*src, *dest, mask);
+}
+
+// dest may be src
+static void premultiplySpan(uint32_t* dest, const uint32_t* src, int n)
+{
+#ifdef SIMD_PIXELS
+	for (; n >= SIMD_PIXELS; n -= SIMD_PIXELS, dest += SIMD_PIXELS, src += SIMD_PIXELS)
+		SIMD_STORE(dest, simdPremultiply(SIMD_LOAD(src)));
+#endif // SIMD_PIXELS
+	for (; n > 0; --n, ++dest, ++src)
+		*dest = premultiplyPixel(*src);
+}
+
+static void copySpanMask(uint32_t* restrict dest, const uint32_t* restrict src, int n, uint32_t mask)
+{
+#ifdef SIMD_PIXELS
+	const simd_t vmask = SIMD_SET32(mask);
+	for (; n >= SIMD_PIXELS; n -= SIMD_PIXELS, dest += SIMD_PIXELS, src += SIMD_PIXELS)
+		SIMD_STORE(dest, simdBlendMask(SIMD_LOAD(src), SIMD_LOAD(dest), vmask));
+#endif // SIMD_PIXELS
+	for (; n > 0; --n, ++dest, ++src)
+		*dest = blendPixelMask(*src, *dest, mask);
+}
+
+static inline void blendFillSpan(const SDL_ContextBitmap* restrict bmp, uint32_t* restrict dest, int n, uint32_t val)
+{
+#define FILL_SPAN(mode) fillSpan##mode(dest, n, val, bmp->mask)
+	BLEND_DISPATCH(bmp->blendMode, FILL_SPAN);
+#undef FILL_SPAN
+}
+
+static inline void blendCopySpan(const SDL_ContextBitmap* restrict bmp, uint32_t* restrict dest, const uint32_t* restrict src, int n)
+{
+#define COPY_SPAN(mode) copySpan##mode(dest, src, n, bmp->mask)
+	BLEND_DISPATCH(bmp->blendMode, COPY_SPAN);
+#undef COPY_SPAN
+}
+
+//
+// Dirty rectangles
+//
+
+// Add x1..x2, y1..y2 to written areas. Rects are merged when their union is no
+// larger than both of them, full set absorbs a rect into the one growing least.
+static void addDirty(SDL_ContextBitmap* restrict bmp, int x1, int y1, int x2, int y2)
+{
+	register SDL_Rect* restrict r = bmp->dirty.rects;
+	register int i, best;
+	long long area, grow, bestGrow;
+	int ux1, uy1, ux2, uy2;
+
+	for (i = 0; i < bmp->dirty.count; ++i)
+		if (x1 >= r[i].x && y1 >= r[i].y && x2 < r[i].x + r[i].w && y2 < r[i].y + r[i].h)
+			return;
+
+	for (;;)
+	{
+		area = (long long)(x2 - x1 + 1) * (y2 - y1 + 1);
+		for (i = 0, best = -1, bestGrow = LLONG_MAX; i < bmp->dirty.count; ++i)
+		{
+			ux1 = MIN(x1, r[i].x), uy1 = MIN(y1, r[i].y);
+			ux2 = MAX(x2, r[i].x + r[i].w - 1), uy2 = MAX(y2, r[i].y + r[i].h - 1);
+			grow = (long long)(ux2 - ux1 + 1) * (uy2 - uy1 + 1) - (long long)r[i].w * r[i].h;
+			if (grow <= area)
+				break;
+			if (grow < bestGrow)
+				best = i, bestGrow = grow;
+		}
+
+		// nothing cheap to merge with and there is room
+		if (i == bmp->dirty.count && bmp->dirty.count < SDL_CONTEXT_DIRTY_RECTS)
 			break;
+
+		// take rect out, go on with union
+		if (i == bmp->dirty.count)
+			i = best;
+		x1 = MIN(x1, r[i].x), y1 = MIN(y1, r[i].y);
+		x2 = MAX(x2, r[i].x + r[i].w - 1), y2 = MAX(y2, r[i].y + r[i].h - 1);
+		r[i] = r[--bmp->dirty.count];
 	}
+
+	r[bmp->dirty.count].x = x1, r[bmp->dirty.count].y = y1;
+	r[bmp->dirty.count].w = x2 - x1 + 1, r[bmp->dirty.count].h = y2 - y1 + 1;
+	++bmp->dirty.count;
+}
+
+// x1..x2, y1..y2 must be inside bitmap, empty areas are ignored
+static inline void markDirty(SDL_ContextBitmap* restrict bmp, int x1, int y1, int x2, int y2)
+{
+	if (bmp->dirty.track && x1 <= x2 && y1 <= y2)
+		addDirty(bmp, x1, y1, x2, y2);
+}
+
+void SDL_ContextBitmapMarkDirty(SDL_ContextBitmap* bmp, int x, int y, int w, int h)
+{
+	markDirty(bmp, MAX(x, 0), MAX(y, 0), MIN(x + w, bmp->width) - 1, MIN(y + h, bmp->height) - 1);
 }
 
 extern inline SDL_ContextBitmap* SDL_ContextCreateBitmap(int width, int height)
@@ -787,6 +1618,8 @@ extern inline SDL_ContextBitmap* SDL_ContextCreateBitmap(int width, int height)
 	bmp->clip.w = width, bmp->clip.h = height;
 	bmp->pitch = width * sizeof(uint32_t);
 	bmp->pixels = xcalloc(1, sizeof(uint32_t[width][height]));
+	bmp->dirty.count = 0, bmp->dirty.track = false;
+	bmp->premultiplied = false;
 	bmp->mask = 0xFFFFFFFF;
 	bmp->blendMode = SDL_BLENDMODE_NONE;
 	bmp->tx = bmp->ty = bmp->shared = 0;
@@ -798,10 +1631,12 @@ extern inline SDL_ContextBitmap* SDL_ContextCloneBitmap(const SDL_ContextBitmap*
 	SDL_ContextBitmap* clone = xmalloc(sizeof(SDL_ContextBitmap));
 	clone->width = bmp->width;
 	clone->height = bmp->height;
-	clone->pitch = bmp->pitch;
+	clone->pitch = bmp->width * sizeof(uint32_t);
 	clone->mask = bmp->mask;
 	clone->blendMode = bmp->blendMode;
 	clone->clip = bmp->clip;
+	clone->dirty = bmp->dirty;
+	clone->premultiplied = bmp->premultiplied;
 	clone->tx = bmp->tx;
 	clone->ty = bmp->ty;
 	if ((clone->shared = bmp->shared))
@@ -809,12 +1644,57 @@ extern inline SDL_ContextBitmap* SDL_ContextCloneBitmap(const SDL_ContextBitmap*
 	else
 	{
 		clone->pixels = xmalloc(sizeof(uint32_t[clone->width][clone->height]));
-		memcpy(clone->pixels, bmp->pixels, bmp->pitch * bmp->height);
+		for (register int y = 0; y < bmp->height; ++y)
+			memcpy(clone->pixels + y * clone->width, bmp->pixels + y * STRIDE(bmp), clone->pitch);
 	}
 	return clone;
 }
 
-extern inline SDL_ContextBitmap* SDL_ContextLoadBitmap(const char path[restrict static 1])
+// Row band job of bulk operations, see SDL_ContextParallelRows
+typedef struct
+{
+	SDL_ContextBitmap* dest;
+	const SDL_ContextBitmap* src;
+	int x, y, x1, x2;
+	uint32_t val;
+}
+BulkRows;
+
+// zero pixels equal to colour key
+static void keyRows(void* data, int y1, int y2)
+{
+	const BulkRows* const job = data;
+	register uint32_t* restrict p;
+	register int n;
+	const uint32_t key = job->val;
+#ifdef SIMD_PIXELS
+	const simd_t k = SIMD_SET32(key);
+	simd_t v;
+#endif // SIMD_PIXELS
+	for (; y1 < y2; ++y1)
+	{
+		p = job->dest->pixels + y1 * STRIDE(job->dest);
+		n = job->dest->width;
+#ifdef SIMD_PIXELS
+		for (; n >= SIMD_PIXELS; n -= SIMD_PIXELS, p += SIMD_PIXELS)
+		{
+			v = SIMD_LOAD(p);
+			SIMD_STORE(p, SIMD_ANDNOT(SIMD_CMPEQ32(v, k), v));
+		}
+#endif // SIMD_PIXELS
+		for (; n > 0; --n, ++p)
+			if (*p == key) *p = 0;
+	}
+}
+
+static void premultiplyRows(void* data, int y1, int y2)
+{
+	const BulkRows* const job = data;
+	for (; y1 < y2; ++y1)
+		premultiplySpan(job->dest->pixels + y1 * STRIDE(job->dest), job->src->pixels + y1 * STRIDE(job->src), job->dest->width);
+}
+
+static SDL_ContextBitmap* loadBitmap(const char path[restrict static 1], bool premultiply)
 {
 	SDL_Surface* restrict tmp = SDL_LoadBMP(path);
 	if (!tmp)
@@ -824,20 +1704,53 @@ extern inline SDL_ContextBitmap* SDL_ContextLoadBitmap(const char path[restrict
 	}
 	tmp = SDL_ConvertSurfaceFormat(tmp, SDL_CONTEXT_PIXELFORMAT, 0);
 	SDL_ContextBitmap* bmp = SDL_ContextCreateBitmap(tmp->clip_rect.w, tmp->clip_rect.h);
-	memcpy(bmp->pixels, tmp->pixels, bmp->pitch * bmp->height);
+	if (premultiply)
+	{
+		// converted while copying out of the surface
+		SDL_ContextBitmap surface = *bmp;
+		surface.pixels = tmp->pixels;
+		surface.pitch = tmp->pitch;
+		BulkRows job = { bmp, &surface, 0, 0, 0, 0, 0 };
+		SDL_ContextParallelRows(0, bmp->height, bmp->width, premultiplyRows, &job);
+		bmp->premultiplied = true;
+	}
+	else
+		for (register int y = 0; y < bmp->height; ++y)
+			memcpy(bmp->pixels + y * bmp->width, (const uint8_t*)tmp->pixels + y * tmp->pitch, bmp->pitch);
 	SDL_FreeSurface(tmp);
 	return bmp;
 }
 
+extern inline SDL_ContextBitmap* SDL_ContextLoadBitmap(const char path[restrict static 1])
+{
+	return loadBitmap(path, false);
+}
+
+extern inline SDL_ContextBitmap* SDL_ContextLoadBitmapPremultiplied(const char* path)
+{
+	return loadBitmap(path, true);
+}
+
 extern inline SDL_ContextBitmap* SDL_ContextLoadBitmapWithTransparent(const char path[restrict static 1], uint32_t transparent)
 {
 	SDL_ContextBitmap* bmp = SDL_ContextLoadBitmap(path);
 	if (!bmp) return NULL;
-	for (register uint32_t* restrict p = bmp->pixels; p < bmp->pixels + bmp->width * bmp->height; ++p)
-		if (*p == transparent) *p = 0;
+	BulkRows job = { bmp, NULL, 0, 0, 0, 0, transparent };
+	SDL_ContextParallelRows(0, bmp->height, bmp->width, keyRows, &job);
 	return bmp;
 }
 
+void SDL_ContextBitmapPremultiply(SDL_ContextBitmap* bmp)
+{
+	if (bmp->premultiplied)
+		return;
+
+	BulkRows job = { bmp, bmp, 0, 0, 0, 0, 0 };
+	SDL_ContextParallelRows(0, bmp->height, bmp->width, premultiplyRows, &job);
+	bmp->premultiplied = true;
+	markDirty(bmp, 0, 0, bmp->width - 1, bmp->height - 1);
+}
+
 extern inline SDL_ContextBitmap* SDL_ContextCreateBitmapShared(uint32_t pixels[], int width, int height)
 {
 	SDL_ContextBitmap* bmp = xmalloc(sizeof(SDL_ContextBitmap));
@@ -850,6 +1763,8 @@ extern inline SDL_ContextBitmap* SDL_ContextCreateBitmapShared(uint32_t pixels[]
 	bmp->clip.h = height;
 	bmp->pitch = width * sizeof(uint32_t);
 	bmp->pixels = pixels;
+	bmp->dirty.count = 0, bmp->dirty.track = false;
+	bmp->premultiplied = false;
 	bmp->tx = bmp->ty = 0;
 	bmp->mask = 0xFFFFFFFF;
 	bmp->blendMode = SDL_BLENDMODE_NONE;
@@ -864,117 +1779,251 @@ extern inline void SDL_ContextDestroyBitmap(SDL_ContextBitmap* bmp)
 	xfree(bmp);
 }
 
+static void copyRows(void* data, int y1, int y2)
+{
+	const BulkRows* const job = data;
+	register const SDL_ContextBitmap* const dest = job->dest, *const src = job->src;
+	register const uint32_t* restrict s = src->pixels + (job->x1 - job->x + src->clip.x1) + (y1 - job->y + src->clip.y1) * STRIDE(src);
+	register uint32_t* restrict d = dest->pixels + job->x1 + y1 * STRIDE(dest);
+
+#define COPY_ROWS(mode) \
+	for (; y1 < y2; ++y1, s += STRIDE(src), d += STRIDE(dest)) \
+		copySpan##mode(d, s, job->x2 - job->x1, dest->mask)
+	COPY_DISPATCH(dest, src, COPY_ROWS);
+#undef COPY_ROWS
+}
+
 void SDL_ContextBitmapCopy(SDL_ContextBitmap* restrict dest, const SDL_ContextBitmap* restrict src, int x, int y)
 {
-	register int x2 = x + src->clip.w - 1, y2 = y + src->clip.h - 1;
-	if ((x < dest->clip.x1 && x2 < dest->clip.x1) || (x > dest->clip.x2 && x2 > dest->clip.x2) || (y < dest->clip.y1 && y2 < dest->clip.y1) || (y > dest->clip.y2 && y2 > dest->clip.y2))
+	const int x1 = MAX(x, dest->clip.x1), y1 = MAX(y, dest->clip.y1);
+	const int x2 = MIN(x + src->clip.w, dest->clip.x2 + 1), y2 = MIN(y + src->clip.h, dest->clip.y2 + 1);
+	if (x1 >= x2 || y1 >= y2)
 		return;
 
-	const int xofs = x < 0 ? -x : 0, yofs = y < 0 ? -y : 0;
+	markDirty(dest, x1, y1, x2 - 1, y2 - 1);
+	BulkRows job = { dest, src, x, y, x1, x2, 0 };
+	SDL_ContextParallelRows(y1, y2, x2 - x1, copyRows, &job);
+}
 
-	x = CLAMP(x, dest->clip.x1, dest->clip.x2);
-	y = CLAMP(y, dest->clip.y1, dest->clip.y2);
-	x2 = CLAMP(x2, dest->clip.x1, dest->clip.x2);
-	y2 = CLAMP(y2, dest->clip.y1, dest->clip.y2);
+// pixels of scaled row expanded at once by SDL_ContextBitmapCopyEx
+#define EXPAND_CHUNK (256)
 
-	for (register int tx, ty = y; ty <= y2; ++ty)
-		for (tx = x; tx <= x2; ++tx)
-			blendPixel(dest, dest->pixels + tx + ty * dest->width,
-			*(src->pixels + (tx - x + xofs + src->clip.x1) + (ty - y + yofs + src->clip.y1) * src->width));
-}	
+// Write n pixels of a scaled source line to out. Source pixels are step apart,
+// each one is replicated s times, the first one only run times.
+static void expandLine(uint32_t* restrict out, const uint32_t* restrict p, int step, int s, int run, int n)
+{
+#ifdef SIMD_PIXELS
+	// mirrored row, reverse four pixels at once
+	if (s == 1 && step == -1)
+		for (; n >= 4; n -= 4, out += 4, p -= 4)
+			_mm_storeu_si128((__m128i*)out, _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)(p - 3)), _MM_SHUFFLE(0, 1, 2, 3)));
+#endif // SIMD_PIXELS
+	if (s == 1)
+		for (; n > 0; --n, p += step)
+			*out++ = *p;
+	else
+		for (register int k; n > 0; n -= k, out += k, p += step, run = s)
+		{
+			k = MIN(run, n);
+			fillSpanNone(out, k, *p, 0);
+		}
+}
 
-// TODO: refactor!
-/* if you read this, sorry >_< */
-void SDL_ContextBitmapCopyEx(SDL_ContextBitmap* restrict dest, const SDL_ContextBitmap* restrict src, int x, int y, int sx, int sy, SDL_ContextTransform transform)
+// side of square blocks rotated blits are split into, so that source and
+// destination lines touched by one block stay in L1
+#define ROTATE_TILE (16)
+
+// Transpose tw x th block: out[j * ROTATE_TILE + i] = p[i * rstep + j * cstep],
+// cstep is 1 or -1.
+static void transposeTile(uint32_t* restrict out, const uint32_t* restrict p, int rstep, int cstep, int tw, int th)
 {
-	if (sx == 0 || sy == 0) return;
+	register int i, j, tw4 = 0, th4 = 0;
+#ifdef SIMD_PIXELS
+	__m128i r0, r1, r2, r3, t0, t1, t2, t3;
+	const uint32_t* restrict q;
+	tw4 = tw & ~3, th4 = th & ~3;
+	for (j = 0; j < th4; j += 4)
+		for (i = 0; i < tw4; i += 4)
+		{
+			// four source rows, four pixels each
+			q = p + i * rstep + (cstep > 0 ? j : -j - 3);
+			r0 = _mm_loadu_si128((const __m128i*)q);
+			r1 = _mm_loadu_si128((const __m128i*)(q + rstep));
+			r2 = _mm_loadu_si128((const __m128i*)(q + 2 * rstep));
+			r3 = _mm_loadu_si128((const __m128i*)(q + 3 * rstep));
+			if (cstep < 0)
+			{
+				r0 = _mm_shuffle_epi32(r0, _MM_SHUFFLE(0, 1, 2, 3));
+				r1 = _mm_shuffle_epi32(r1, _MM_SHUFFLE(0, 1, 2, 3));
+				r2 = _mm_shuffle_epi32(r2, _MM_SHUFFLE(0, 1, 2, 3));
+				r3 = _mm_shuffle_epi32(r3, _MM_SHUFFLE(0, 1, 2, 3));
+			}
+			t0 = _mm_unpacklo_epi32(r0, r1);
+			t1 = _mm_unpacklo_epi32(r2, r3);
+			t2 = _mm_unpackhi_epi32(r0, r1);
+			t3 = _mm_unpackhi_epi32(r2, r3);
+			_mm_storeu_si128((__m128i*)(out + j * ROTATE_TILE + i), _mm_unpacklo_epi64(t0, t1));
+			_mm_storeu_si128((__m128i*)(out + (j + 1) * ROTATE_TILE + i), _mm_unpackhi_epi64(t0, t1));
+			_mm_storeu_si128((__m128i*)(out + (j + 2) * ROTATE_TILE + i), _mm_unpacklo_epi64(t2, t3));
+			_mm_storeu_si128((__m128i*)(out + (j + 3) * ROTATE_TILE + i), _mm_unpackhi_epi64(t2, t3));
+		}
+#endif // SIMD_PIXELS
+	for (j = 0; j < th; ++j)
+		for (i = j < th4 ? tw4 : 0; i < tw; ++i)
+			out[j * ROTATE_TILE + i] = p[i * rstep + j * cstep];
+}
 
-	register int
-		x2 = x + src->clip.w * (transform & SDL_ROTATE ? sy : sx) - 1,
-		y2 = y + src->clip.h * (transform & SDL_ROTATE ? sx : sy) - 1;
+// Nearest neighbour scaled blit. Source line and column for the first visible
+// pixel are found once, after that runs of replicated pixels are walked without
+// divisions. Every expanded source line is blended into all destination rows it
+// covers. sx and sy scale source axes, transform is applied after scaling.
+void SDL_ContextBitmapCopyEx(SDL_ContextBitmap* restrict dest, const SDL_ContextBitmap* restrict src, int x, int y, int sx, int sy, SDL_ContextTransform transform)
+{
+	if (sx <= 0 || sy <= 0) return;
 
-	if ((x < dest->clip.x1 && x2 < dest->clip.x1) || (x > dest->clip.x2 && x2 > dest->clip.x2) || (y < dest->clip.y1 && y2 < dest->clip.y1) || (y > dest->clip.y2 && y2 > dest->clip.y2))
+	// plain copy, rows go straight to the span kernels
+	if (transform == SDL_TRANSFORM_NONE && sx == 1 && sy == 1)
+	{
+		SDL_ContextBitmapCopy(dest, src, x, y);
 		return;
+	}
 
-	const int xofs = (x < 0 ? -x : 0), yofs = (y < 0 ? -y : 0);
+	// source axis along destination x and y, mirroring of destination axes
+	const bool rotate = transform & SDL_ROTATE;
+	const bool mx = transform & SDL_FLIP_V, my = !(transform & SDL_FLIP_H) != !rotate;
+	const int scx = rotate ? sy : sx, scy = rotate ? sx : sy;
+	const int stepx = rotate ? STRIDE(src) : 1, stepy = rotate ? 1 : STRIDE(src);
+	const int dw = (rotate ? src->clip.h : src->clip.w) * scx, dh = (rotate ? src->clip.w : src->clip.h) * scy;
 
-	x = CLAMP(x, dest->clip.x1, dest->clip.x2);
-	y = CLAMP(y, dest->clip.y1, dest->clip.y2);
-	x2 = CLAMP(x2, dest->clip.x1, dest->clip.x2);
-	y2 = CLAMP(y2, dest->clip.y1, dest->clip.y2);
+	const int x1 = MAX(x, dest->clip.x1), y1 = MAX(y, dest->clip.y1);
+	const int x2 = MIN(x + dw - 1, dest->clip.x2), y2 = MIN(y + dh - 1, dest->clip.y2);
+	if (x1 > x2 || y1 > y2)
+		return;
+	markDirty(dest, x1, y1, x2, y2);
 
-	register int kx = transform & SDL_FLIP_V ? x2 + x : 0, ky = transform & SDL_FLIP_H ? y2 + y : 0;
+	const uint32_t* restrict origin = src->pixels + src->clip.x1 + src->clip.y1 * STRIDE(src);
 
-	switch (transform & SDL_ROTATE)
+	// 1:1 rotation, source columns are gathered by transposing small blocks
+	if (rotate && sx == 1 && sy == 1)
 	{
-		case 0: // without rotation
-			for (register int tx, ty = y; ty <= y2; ++ty)
-				for (tx = x; tx <= x2; ++tx)
-					blendPixel(dest, dest->pixels + (kx ? (kx - tx) : tx) + ((ky ? (ky - ty) : ty)) * dest->width, src->pixels[tx / sx - x + src->clip.x1 + xofs + (ty / sy - y + src->clip.y1 + yofs) * src->width]);
-			break;
-		default: // with rotation
-			ky = ky ? 0 : y2 + y;
-			for (register int tx, ty = y; ty <= y2; ++ty)
-				for (tx = x; tx <= x2; ++tx)
-					blendPixel(dest, dest->pixels + (kx ? (kx - tx) : tx) + ((ky ? (ky - ty) : ty)) * dest->width, src->pixels[ty / sy - y + src->clip.x1 + yofs + (tx / sx - x + src->clip.y1 + xofs) * src->width]);
-			break;
+		uint32_t tile[ROTATE_TILE * ROTATE_TILE];
+		register int tx, ty, tw, th, k;
+#define COPY_ROTATED(mode) \
+	for (ty = y1; ty <= y2; ty += ROTATE_TILE) \
+		for (tx = x1; tx <= x2; tx += ROTATE_TILE) \
+		{ \
+			tw = MIN(ROTATE_TILE, x2 - tx + 1), th = MIN(ROTATE_TILE, y2 - ty + 1); \
+			transposeTile(tile, origin + (mx ? dw - 1 - (tx - x) : tx - x) * STRIDE(src) + (my ? dh - 1 - (ty - y) : ty - y), \
+				mx ? -STRIDE(src) : STRIDE(src), my ? -1 : 1, tw, th); \
+			for (k = 0; k < th; ++k) \
+				copySpan##mode(dest->pixels + tx + (ty + k) * STRIDE(dest), tile + k * ROTATE_TILE, tw, dest->mask); \
+		}
+		COPY_DISPATCH(dest, src, COPY_ROTATED);
+#undef COPY_ROTATED
+		return;
 	}
-}
 
-// TODO: remove this, refactor SDL_ContextBitmapDrawBitmap
-static inline int max(int a, int b)
-{
-	return MAX(a, b);
+	uint32_t buf[EXPAND_CHUNK];
+	register uint32_t* restrict d = dest->pixels + x1 + y1 * STRIDE(dest);
+	const uint32_t* restrict line;
+	int q = my ? dh - 1 - (y1 - y) : y1 - y;
+	int run = my ? q % scy + 1 : scy - q % scy;
+	int rows = y2 - y1 + 1, n, cx, k;
+
+#define COPY_EX(mode) \
+	for (line = origin + q / scy * stepy; rows > 0; rows -= run, line += my ? -stepy : stepy, run = scy) \
+	{ \
+		run = MIN(run, rows); \
+		for (cx = x1; cx <= x2; cx += n) \
+		{ \
+			n = MIN(x2 - cx + 1, EXPAND_CHUNK); \
+			q = mx ? dw - 1 - (cx - x) : cx - x; \
+			expandLine(buf, line + q / scx * stepx, mx ? -stepx : stepx, scx, mx ? q % scx + 1 : scx - q % scx, n); \
+			for (k = 0; k < run; ++k) \
+				copySpan##mode(d + (cx - x1) + k * STRIDE(dest), buf, n, dest->mask); \
+		} \
+		d += run * STRIDE(dest); \
+	}
+	COPY_DISPATCH(dest, src, COPY_EX);
+#undef COPY_EX
 }
 
-static inline int min(int a, int b)
+// narrow [l, r] to t where 0 <= k * t + c <= m
+static void limitSpan(double* l, double* r, double k, double c, double m)
 {
-	return MIN(a, b);
+	if (k > 0)
+	{
+		*l = MAX(*l, -c / k);
+		*r = MIN(*r, (m - c) / k);
+	}
+	else if (k < 0)
+	{
+		*l = MAX(*l, (m - c) / k);
+		*r = MIN(*r, -c / k);
+	}
+	else if (c < 0 || c > m)
+		*r = *l - 1;
 }
 
-// TODO: optimize!!!
-// TODO: if (sx == 1 and sy == 1 and a == 0) => SDL_ContextBitmapCopy(...)
-// TODO: if (sx > 1 and sy > 1 and a == 0) => fast copy scaled bitmap method
+// Destination offset (tx, ty) samples source point
+//   u = tx * ca - ty * sb + ox, v = tx * sb + ty * ca + oy.
+// For every destination row the span where (u, v) lies inside source clip is
+// solved exactly, then u and v are stepped in 16.16 fixed point along it.
+// Stepping starts from the row origin, so pixels don't depend on the clip.
 void SDL_ContextBitmapDrawBitmap(SDL_ContextBitmap* restrict dest, const SDL_ContextBitmap* restrict src,
 	int x, int y, float a, int ox, int oy, float sx, float sy)
 {
-	const float s = -sinf(a), c = cosf(a);
-	const float sx_cos = sx * c, sy_sin = sy * s;
-
-	// left top corner
-	const int rx1 = (-ox) * sx_cos + (-oy) * sy_sin;
-	const int ry1 = (+ox) * sy_sin + (-oy) * sx_cos;
-	
-	// right top corner                                 
-	const int rx2 = ( src->clip.w - ox) * sx_cos + (-oy) * sy_sin;
-	const int ry2 = (-src->clip.w + ox) * sy_sin + (-oy) * sx_cos;
-
-	// left bottom corner	                            
-	const int rx3 = (-ox) * sx_cos + (src->clip.h - oy) * sy_sin;
-	const int ry3 = (+ox) * sy_sin + (src->clip.h - oy) * sx_cos;
+	if (sx == 0.f || sy == 0.f)
+		return;
 
-	// right bottom corner                         
-	const int rx4 = ( src->clip.w - ox) * sx_cos + (src->clip.h - oy) * sy_sin;
-	const int ry4 = (-src->clip.w + ox) * sy_sin + (src->clip.h - oy) * sx_cos;
+	// neither rotated nor scaled
+	if (a == 0.f && sx == 1.f && sy == 1.f)
+	{
+		SDL_ContextBitmapCopy(dest, src, x - ox, y - oy);
+		return;
+	}
 
-	// final start (x, y) and end (x, y)
-	int strx = min(rx1, min(rx2, min(rx3, rx4))), ex = max(rx1, max(rx2, max(rx3, rx4)));
-	register int ty = min(ry1, min(ry2, min(ry3, ry4)));
-	int ey = max(ry1, max(ry2, max(ry3, ry4)));
+	const double ca = cosf(a) / sx, sb = -sinf(a) / sy, det = ca * ca + sb * sb;
+	const double w = src->clip.w - 1, h = src->clip.h - 1;
 
-	sx = c / sx, sy = s / sy;
+	// rows covered by source corners, clipped against destination
+	double tymin = 0, tymax = 0, t;
+	for (register int i = 0; i < 4; ++i)
+	{
+		t = (-sb * ((i & 1 ? w : 0) - ox) + ca * ((i & 2 ? h : 0) - oy)) / det;
+		tymin = i ? MIN(tymin, t) : t;
+		tymax = i ? MAX(tymax, t) : t;
+	}
+	const int ty1 = MAX((int)floor(tymin), dest->clip.y1 - y), ty2 = MIN((int)ceil(tymax), dest->clip.y2 - y);
 
-	register float nx, ny;
-	for (; ty <= ey; ++ty)
-		for (register int tx = strx; tx <= ex; ++tx)
-		{
-			nx = tx * sx - ty * sy + ox,
-			ny = tx * sy + ty * sx + oy;
-			if (IN_BOUNDS(nx, 0, src->clip.w - 1) && IN_BOUNDS(ny, 0, src->clip.h - 1))
-				SDL_ContextBitmapDrawPoint(dest,
-					tx + x, ty + y,
-					src->pixels[(int)(nx + src->clip.x1 + 0.5f) + (int)(ny + src->clip.y1 + 0.5f) * src->width]);
-		}
+	const uint32_t* restrict s = src->pixels + src->clip.x1 + src->clip.y1 * STRIDE(src);
+	const int32_t du = (int32_t)floor(ca * 65536. + .5), dv = (int32_t)floor(sb * 65536. + .5);
+	register int32_t u, v;
+	register int n;
+	register uint32_t* restrict p;
+	double l, r, cu, cv;
+	int xl = INT_MAX, xr = INT_MIN, yl = INT_MAX, yr = INT_MIN;
+
+#define DRAW_BITMAP(mode) \
+	for (register int ty = ty1; ty <= ty2; ++ty) \
+	{ \
+		cu = ox - ty * sb, cv = oy + ty * ca; \
+		l = dest->clip.x1 - x, r = dest->clip.x2 - x; \
+		limitSpan(&l, &r, ca, cu, w); \
+		limitSpan(&l, &r, sb, cv, h); \
+		const int txa = (int)ceil(l), txb = (int)floor(r); \
+		if (txa > txb) continue; \
+		xl = MIN(xl, txa), xr = MAX(xr, txb), yl = MIN(yl, ty), yr = MAX(yr, ty); \
+		u = (int32_t)(floor((cu + .5) * 65536.) + (double)txa * du); \
+		v = (int32_t)(floor((cv + .5) * 65536.) + (double)txa * dv); \
+		p = dest->pixels + txa + x + (ty + y) * STRIDE(dest); \
+		for (n = txb - txa + 1; n > 0; --n, ++p, u += du, v += dv) \
+			*p = blendPixel##mode(s[(u >> 16) + (v >> 16) * STRIDE(src)], *p, dest->mask); \
+	}
+	COPY_DISPATCH(dest, src, DRAW_BITMAP);
+#undef DRAW_BITMAP
+	if (yl <= yr)
+		markDirty(dest, xl + x, yl + y, xr + x, yr + y);
 }
 
 extern inline void SDL_ContextBitmapClip(SDL_ContextBitmap* bmp, int x, int y, int w, int h)
@@ -989,15 +2038,31 @@ extern inline void SDL_ContextBitmapClip(SDL_ContextBitmap* bmp, int x, int y, i
 
 extern inline uint32_t SDL_ContextBitmapGetPixel(const SDL_ContextBitmap* bmp, int x, int y)
 {
-	return (x < bmp->clip.x1 || y < bmp->clip.y1 || x > bmp->clip.x2 || y > bmp->clip.y2) ? 0 : bmp->pixels[x + y * bmp->width];
+	return (x < bmp->clip.x1 || y < bmp->clip.y1 || x > bmp->clip.x2 || y > bmp->clip.y2) ? 0 : bmp->pixels[x + y * STRIDE(bmp)];
+}
+
+static void clearRows(void* data, int y1, int y2)
+{
+	const BulkRows* const job = data;
+	register const SDL_ContextBitmap* const bmp = job->dest;
+	register uint32_t* restrict p = bmp->pixels + bmp->clip.x1 + y1 * STRIDE(bmp);
+
+	// full width clip of unpadded rows is one contiguous block
+	if (bmp->clip.w == STRIDE(bmp))
+	{
+		fillBlock(p, bmp->clip.w * (y2 - y1), job->val, bmp->clip.w * bmp->clip.h * sizeof(uint32_t) >= SDL_CONTEXT_STREAM_BYTES);
+		return;
+	}
+
+	for (; y1 < y2; ++y1, p += STRIDE(bmp))
+		fillSpanNone(p, bmp->clip.w, job->val, 0);
 }
 
 extern inline void SDL_ContextBitmapClear(SDL_ContextBitmap* restrict bmp, uint32_t val)
 {
-	register uint32_t* restrict p;
-	for (register int y = bmp->clip.y1; y <= bmp->clip.y2; ++y)
-		for (p = bmp->pixels + y * bmp->width + bmp->clip.x1; p <= bmp->pixels + y * bmp->width + bmp->clip.x2; ++p)
-			*p = val;
+	BulkRows job = { bmp, NULL, 0, 0, 0, 0, val };
+	markDirty(bmp, bmp->clip.x1, bmp->clip.y1, bmp->clip.x2, bmp->clip.y2);
+	SDL_ContextParallelRows(bmp->clip.y1, bmp->clip.y2 + 1, bmp->clip.w, clearRows, &job);
 }
 
 extern inline void SDL_ContextBitmapDrawPoint(SDL_ContextBitmap* bmp, int x, int y, uint32_t val)
@@ -1005,81 +2070,118 @@ extern inline void SDL_ContextBitmapDrawPoint(SDL_ContextBitmap* bmp, int x, int
 	if (x < bmp->clip.x1 || y < bmp->clip.y1 || x > bmp->clip.x2 || y > bmp->clip.y2)
 		return;
 
-	blendPixel(bmp, bmp->pixels + x + y * bmp->width, val);
+	blendPixel(bmp, bmp->pixels + x + y * STRIDE(bmp), val);
+	markDirty(bmp, x, y, x, y);
 }
 
-// TODO: replace with Brethanham's line
-// TODO: add some optimizations (when line is vertical, horizontal, etc.)
-extern inline void SDL_ContextBitmapDrawLine(SDL_ContextBitmap* bmp, int x1, int y1, int x2, int y2, uint32_t val)
+// Bresenham's line: steps go along major axis, minor axis advances when
+// error overflows. Segment is clipped before stepping, so the pixels drawn
+// are exactly those of the unclipped line. Pixels before step first are
+// skipped (joints of polylines are drawn once).
+typedef struct
 {
-	const int dx = x2 - x1, dy = y2 - y1;
-	register int step = ABS(dx) > ABS(dy) ? ABS(dx) : ABS(dy);
-	float x_inc = dx / (float)step, y_inc = dy / (float)step;
-	register float x = x1, y = y1;
+	int offset; // first pixel
+	int n, err, da, db, stepa, stepb;
+}
+LineSteps;
 
-	while (step-- >= 0)
-	{
-		SDL_ContextBitmapDrawPoint(bmp, round(x), round(y), val);
-		x += x_inc, y += y_inc;	
+// Clip a segment which is not axis-aligned against cx1..cx2, cy1..cy2 of
+// rows stride pixels apart, false if nothing is left
+static bool clipSegment(int cx1, int cy1, int cx2, int cy2, int stride, int x1, int y1, int x2, int y2, int first, LineSteps* restrict s)
+{
+	const bool steep = ABS(y2 - y1) > ABS(x2 - x1);
+	const int sx = x2 > x1 ? 1 : -1, sy = y2 > y1 ? 1 : -1;
+	const int sa = steep ? sy : sx, sb = steep ? sx : sy;
+	const int a1 = steep ? y1 : x1, b1 = steep ? x1 : y1;
+	const int amin = steep ? cy1 : cx1, amax = steep ? cy2 : cx2;
+	const int bmin = steep ? cx1 : cy1, bmax = steep ? cx2 : cy2;
+	const long long D = steep ? ABS(y2 - y1) : ABS(x2 - x1), E = steep ? ABS(x2 - x1) : ABS(y2 - y1);
+
+	// pixel i lies at a1 + sa * i, b1 + sb * k(i), k(i) = (2 * i * E + D) / (2 * D)
+	long long i1 = first, i2 = D, k1 = 0, k2 = E;
+	i1 = MAX(i1, sa > 0 ? amin - a1 : a1 - amax);
+	i2 = MIN(i2, sa > 0 ? amax - a1 : a1 - amin);
+	k1 = MAX(k1, sb > 0 ? bmin - b1 : b1 - bmax);
+	k2 = MIN(k2, sb > 0 ? bmax - b1 : b1 - bmin);
+	if (k1 > k2)
+		return false;
+	if (k1 > 0)
+		i1 = MAX(i1, (2 * D * k1 - D + 2 * E - 1) / (2 * E));
+	if (k2 < E)
+		i2 = MIN(i2, (2 * D * (k2 + 1) - D - 1) / (2 * E));
+	if (i1 > i2)
+		return false;
+
+	const long long k = (2 * i1 * E + D) / (2 * D);
+	s->da = 2 * E, s->db = 2 * D;
+	s->stepa = steep ? sy * stride : sx, s->stepb = steep ? sx : sy * stride;
+	s->err = (2 * i1 * E + D) % (2 * D), s->n = i2 - i1 + 1;
+	s->offset = (steep ? b1 + sb * k : a1 + sa * i1) + (steep ? a1 + sa * i1 : b1 + sb * k) * stride;
+	return true;
+}
+
+// walk p over pixels of clipped segment, plot writes *p
+#define STEP_SEGMENT(s, p, plot) \
+	for (register int n = (s).n, err = (s).err; n > 0; --n, p += (s).stepa) \
+	{ \
+		plot; \
+		if ((err += (s).da) >= (s).db) \
+		{ \
+			err -= (s).db; \
+			p += (s).stepb; \
+		} \
 	}
+
+extern inline void SDL_ContextBitmapDrawLine(SDL_ContextBitmap* bmp, int x1, int y1, int x2, int y2, uint32_t val)
+{
+	const SDL_Point points[2] = { { x1, y1 }, { x2, y2 } };
+	SDL_ContextBitmapDrawLines(bmp, points, 2, val);
 }
 
 extern inline void SDL_ContextBitmapDrawRect(SDL_ContextBitmap* bmp, int x, int y, int w, int h, uint32_t val)
 {
-	--w; --h;
-	SDL_ContextBitmapFillRect(bmp, x + 1, y, w, 1, val);
-	SDL_ContextBitmapFillRect(bmp, x, y + h, w, 1, val);
-	SDL_ContextBitmapFillRect(bmp, x, y, 1, h, val);
-	SDL_ContextBitmapFillRect(bmp, x + w, y + 1, 1, h, val);
+	const SDL_Rect rect = { x, y, w, h };
+	SDL_ContextBitmapDrawRects(bmp, &rect, 1, val);
 }
 
-extern inline void SDL_ContextBitmapFillRect(SDL_ContextBitmap* bmp, int x, int y, int w, int h, uint32_t val)
+// clip [x, x2) x [y, y2) against bmp->clip, false if nothing left
+static bool clipRect(const SDL_ContextBitmap* bmp, int* x, int* y, int* x2, int* y2)
 {
-	register int x2 = x + w, y2 = y + h;
-	if ((x < bmp->clip.x1 && x2 < bmp->clip.x1) || (x > bmp->clip.x2 && x2 > bmp->clip.x2) || (y < bmp->clip.y1 && y2 < bmp->clip.y1) || (y > bmp->clip.y2 && y2 > bmp->clip.y2))
-		return;
-
-	x = CLAMP(x, bmp->clip.x1, bmp->clip.x2);
-	x2 = CLAMP(x2, bmp->clip.x1, bmp->clip.x2);
-	y = CLAMP(y, bmp->clip.y1, bmp->clip.y2);
-	y2 = CLAMP(y2, bmp->clip.y1, bmp->clip.y2);
+	if (*x2 <= bmp->clip.x1 || *x > bmp->clip.x2 || *y2 <= bmp->clip.y1 || *y > bmp->clip.y2)
+		return false;
 
-	for (register int tx, ty; y < y2; ++y)
-	{
-		ty = bmp->width * y;
-		for (tx = x + ty; tx < x2 + ty; ++tx)
-			blendPixel(bmp, bmp->pixels + tx, val);
-	}
+	*x = MAX(*x, bmp->clip.x1);
+	*x2 = MIN(*x2, bmp->clip.x2 + 1);
+	*y = MAX(*y, bmp->clip.y1);
+	*y2 = MIN(*y2, bmp->clip.y2 + 1);
+	return true;
 }
 
-// TODO: make circles shape identically?
-extern inline void SDL_ContextBitmapDrawCircle(SDL_ContextBitmap* bmp, int xm, int ym, int r, uint32_t val)
+void SDL_ContextBitmapFillRect(SDL_ContextBitmap* bmp, int x, int y, int w, int h, uint32_t val)
 {
-	register int x = -r, y = 0, err = 2 - 2 * r;
-	if (xm + x < bmp->clip.x1 || xm - x > bmp->clip.x2 || ym - x < bmp->clip.y1 || ym - y > bmp->clip.y2)
+	int x2 = x + w, y2 = y + h;
+	if (w <= 0 || h <= 0 || !clipRect(bmp, &x, &y, &x2, &y2))
 		return;
-	do 
-	{
-		SDL_ContextBitmapDrawPoint(bmp, xm - x, ym + y, val);
-		SDL_ContextBitmapDrawPoint(bmp, xm - y, ym - x, val);
-		SDL_ContextBitmapDrawPoint(bmp, xm + x, ym - y, val);
-		SDL_ContextBitmapDrawPoint(bmp, xm + y, ym + x, val);
 
-		r = err;
-		if (r <= y) err += ++y * 2 + 1;
-		if (r > x || err > y) err += ++x * 2 + 1;
-	}
-	while (x < 0);
+	markDirty(bmp, x, y, x2 - 1, y2 - 1);
+	register uint32_t* restrict p = bmp->pixels + x + y * STRIDE(bmp);
+#define FILL_ROWS(mode) \
+	for (; y < y2; ++y, p += STRIDE(bmp)) \
+		fillSpan##mode(p, x2 - x, val, bmp->mask)
+	BLEND_DISPATCH(bmp->blendMode, FILL_ROWS);
+#undef FILL_ROWS
+}
+
+extern inline void SDL_ContextBitmapDrawCircle(SDL_ContextBitmap* bmp, int xm, int ym, int r, uint32_t val)
+{
+	const SDL_ContextCircle circle = { xm, ym, r };
+	SDL_ContextBitmapDrawCircles(bmp, &circle, 1, val);
 }
 
 extern inline void SDL_ContextBitmapFillCircle(SDL_ContextBitmap* bmp, int xm, int ym, int r, uint32_t val)
 {
-	register int x, y;
-	r *= r;
-	for (x = xm - r; x <= xm + r; ++x)
-		for (y = ym - r; y <= ym + r; ++y)
-			if ((pow(x - xm, 2) + pow(y - ym, 2)) <= r)
-				SDL_ContextBitmapDrawPoint(bmp, x, y, val);
+	const SDL_ContextCircle circle = { xm, ym, r };
+	SDL_ContextBitmapFillCircles(bmp, &circle, 1, val);
 }
 
 extern inline void SDL_ContextBitmapDrawTriangle(SDL_ContextBitmap* bmp, int x1, int y1, int x2, int y2, int x3, int y3, uint32_t val)
@@ -1089,87 +2191,301 @@ extern inline void SDL_ContextBitmapDrawTriangle(SDL_ContextBitmap* bmp, int x1,
 	SDL_ContextBitmapDrawLine(bmp, x3, y3, x1, y1, val);
 }
 
-void SDL_ContextBitmapFillTriangle(SDL_ContextBitmap* bmp, int x1, int y1, int x2, int y2, int x3, int y3, uint32_t val)
+//
+// Batched primitives, blend mode is selected once per batch and bounds of
+// all drawn pixels are marked dirty once
+//
+
+#define GROW_BOUNDS(x1, y1, x2, y2) \
+	(xl = MIN(xl, x1), yl = MIN(yl, y1), xr = MAX(xr, x2), yr = MAX(yr, y2))
+
+// clipped row xa..xb of y, clipped column ya..yb of x and clipped pixel
+#define BATCH_HSPAN(mode, xa, xb, y) \
+	do { \
+		const int sx1 = MAX(xa, bmp->clip.x1), sx2 = MIN(xb, bmp->clip.x2), sy = (y); \
+		if (sx1 <= sx2 && IN_BOUNDS(sy, bmp->clip.y1, bmp->clip.y2)) \
+		{ \
+			fillSpan##mode(bmp->pixels + sx1 + sy * STRIDE(bmp), sx2 - sx1 + 1, val, bmp->mask); \
+			GROW_BOUNDS(sx1, sy, sx2, sy); \
+		} \
+	} while (0)
+#define BATCH_VSPAN(mode, x, ya, yb) \
+	do { \
+		const int sx = (x), sy1 = MAX(ya, bmp->clip.y1), sy2 = MIN(yb, bmp->clip.y2); \
+		if (sy1 <= sy2 && IN_BOUNDS(sx, bmp->clip.x1, bmp->clip.x2)) \
+		{ \
+			register uint32_t* restrict q = bmp->pixels + sx + sy1 * STRIDE(bmp); \
+			for (register int n = sy2 - sy1 + 1; n > 0; --n, q += STRIDE(bmp)) \
+				*q = blendPixel##mode(val, *q, bmp->mask); \
+			GROW_BOUNDS(sx, sy1, sx, sy2); \
+		} \
+	} while (0)
+#define BATCH_PLOT(mode, x, y) \
+	do { \
+		const int sx = (x), sy = (y); \
+		if (IN_BOUNDS(sx, bmp->clip.x1, bmp->clip.x2) && IN_BOUNDS(sy, bmp->clip.y1, bmp->clip.y2)) \
+		{ \
+			register uint32_t* restrict q = bmp->pixels + sx + sy * STRIDE(bmp); \
+			*q = blendPixel##mode(val, *q, bmp->mask); \
+		} \
+	} while (0)
+
+void SDL_ContextBitmapDrawPoints(SDL_ContextBitmap* bmp, const SDL_Point points[], int count, uint32_t val)
 {
-	// sort vertices coordinates
-	int tmp;
-	if (y1 > y2)
-	{
-		tmp = y1, y1 = y2, y2 = tmp;
-		tmp = x1, x1 = x2, x2 = tmp;
+	register const SDL_Point* restrict p = points, *end = points + count;
+	register uint32_t* restrict d;
+	int xl = INT_MAX, xr = INT_MIN, yl = INT_MAX, yr = INT_MIN;
+#define DRAW_POINTS(mode) \
+	for (; p < end; ++p) \
+		if (IN_BOUNDS(p->x, bmp->clip.x1, bmp->clip.x2) && IN_BOUNDS(p->y, bmp->clip.y1, bmp->clip.y2)) \
+		{ \
+			d = bmp->pixels + p->x + p->y * STRIDE(bmp); \
+			*d = blendPixel##mode(val, *d, bmp->mask); \
+			GROW_BOUNDS(p->x, p->y, p->x, p->y); \
+		}
+	BLEND_DISPATCH(bmp->blendMode, DRAW_POINTS);
+#undef DRAW_POINTS
+	markDirty(bmp, xl, yl, xr, yr);
+}
+
+// Connected segments like SDL_RenderDrawLines, shared points are drawn once.
+// Axis-aligned segments are spans, others are stepped after clipping.
+void SDL_ContextBitmapDrawLines(SDL_ContextBitmap* bmp, const SDL_Point points[], int count, uint32_t val)
+{
+	register uint32_t* restrict p;
+	int x1, y1, x2, y2, xl = INT_MAX, xr = INT_MIN, yl = INT_MAX, yr = INT_MIN;
+	LineSteps s;
+#define DRAW_LINES(mode) \
+	for (register int i = 1; i < count; ++i) \
+	{ \
+		x1 = points[i - 1].x, y1 = points[i - 1].y, x2 = points[i].x, y2 = points[i].y; \
+		if (x1 == x2 || y1 == y2) \
+		{ \
+			if (i > 1) \
+			{ \
+				if (x1 == x2 && y1 == y2) continue; \
+				if (x1 != x2) x1 += x2 > x1 ? 1 : -1; \
+				else y1 += y2 > y1 ? 1 : -1; \
+			} \
+			if (y1 == y2) BATCH_HSPAN(mode, MIN(x1, x2), MAX(x1, x2), y1); \
+			else BATCH_VSPAN(mode, x1, MIN(y1, y2), MAX(y1, y2)); \
+		} \
+		else if (clipSegment(bmp->clip.x1, bmp->clip.y1, bmp->clip.x2, bmp->clip.y2, STRIDE(bmp), x1, y1, x2, y2, i > 1, &s)) \
+		{ \
+			p = bmp->pixels + s.offset; \
+			STEP_SEGMENT(s, p, *p = blendPixel##mode(val, *p, bmp->mask)); \
+			GROW_BOUNDS(MAX(MIN(x1, x2), bmp->clip.x1), MAX(MIN(y1, y2), bmp->clip.y1), \
+				MIN(MAX(x1, x2), bmp->clip.x2), MIN(MAX(y1, y2), bmp->clip.y2)); \
+		} \
 	}
-	if (y1 > y3)
-	{
-		tmp = y1, y1 = y3, y3 = tmp;
-		tmp = x1, x1 = x3, x3 = tmp;
+	BLEND_DISPATCH(bmp->blendMode, DRAW_LINES);
+#undef DRAW_LINES
+	markDirty(bmp, xl, yl, xr, yr);
+}
+
+void SDL_ContextBitmapDrawRects(SDL_ContextBitmap* bmp, const SDL_Rect rects[], int count, uint32_t val)
+{
+	register const SDL_Rect* restrict r = rects, *end = rects + count;
+	int x, y, w, h, xl = INT_MAX, xr = INT_MIN, yl = INT_MAX, yr = INT_MIN;
+#define DRAW_RECTS(mode) \
+	for (; r < end; ++r) \
+	{ \
+		x = r->x, y = r->y, w = r->w - 1, h = r->h - 1; \
+		BATCH_HSPAN(mode, x + 1, x + w, y); \
+		BATCH_HSPAN(mode, x, x + w - 1, y + h); \
+		BATCH_VSPAN(mode, x, y, y + h - 1); \
+		BATCH_VSPAN(mode, x + w, y + 1, y + h); \
 	}
-	if (y2 > y3)
-	{
-		tmp = y2, y2 = y3, y3 = tmp;
-		tmp = x2, x2 = x3, x3 = tmp;
+	BLEND_DISPATCH(bmp->blendMode, DRAW_RECTS);
+#undef DRAW_RECTS
+	markDirty(bmp, xl, yl, xr, yr);
+}
+
+void SDL_ContextBitmapFillRects(SDL_ContextBitmap* bmp, const SDL_Rect rects[], int count, uint32_t val)
+{
+	register const SDL_Rect* restrict r = rects, *end = rects + count;
+	register uint32_t* restrict p;
+	int x, y, x2, y2, xl = INT_MAX, xr = INT_MIN, yl = INT_MAX, yr = INT_MIN;
+#define FILL_RECTS(mode) \
+	for (; r < end; ++r) \
+	{ \
+		x = r->x, y = r->y, x2 = r->x + r->w, y2 = r->y + r->h; \
+		if (r->w <= 0 || r->h <= 0 || !clipRect(bmp, &x, &y, &x2, &y2)) continue; \
+		GROW_BOUNDS(x, y, x2 - 1, y2 - 1); \
+		for (p = bmp->pixels + x + y * STRIDE(bmp); y < y2; ++y, p += STRIDE(bmp)) \
+			fillSpan##mode(p, x2 - x, val, bmp->mask); \
 	}
+	BLEND_DISPATCH(bmp->blendMode, FILL_RECTS);
+#undef FILL_RECTS
+	markDirty(bmp, xl, yl, xr, yr);
+}
 
-	// to shape identically with SDL_ContextBitmapDrawTriangle
-	SDL_ContextBitmapDrawLine(bmp, x1, y1, x2, y2, val);
-	SDL_ContextBitmapDrawLine(bmp, x2, y2, x3, y3, val);
-	SDL_ContextBitmapDrawLine(bmp, x3, y3, x1, y1, val);
-	
-	if (y2 == y3) // draw bottom flat triangle
-	{
-		register const float invslope1 = (float)(x2 - x1) / (float)(y2 - y1);
-		register const float invslope2 = (float)(x3 - x1) / (float)(y3 - y1);
-	
-		register float curx1 = x1, curx2 = x1;
-	
-		for (register int y = y1; y <= y2; ++y)
-		{
-			SDL_ContextBitmapDrawLine(bmp, curx1, y, curx2, y, val);
-			curx1 += invslope1;
-			curx2 += invslope2;
-		}	
+// TODO: make circles shape identically?
+void SDL_ContextBitmapDrawCircles(SDL_ContextBitmap* bmp, const SDL_ContextCircle circles[], int count, uint32_t val)
+{
+	register const SDL_ContextCircle* restrict c = circles, *end = circles + count;
+	register int x, y, err, e;
+	int xm, ym, xl = INT_MAX, xr = INT_MIN, yl = INT_MAX, yr = INT_MIN;
+#define DRAW_CIRCLES(mode) \
+	for (; c < end; ++c) \
+	{ \
+		xm = c->x, ym = c->y, x = -c->r, y = 0, err = 2 - 2 * c->r; \
+		if (c->r < 0 || xm + c->r < bmp->clip.x1 || xm - c->r > bmp->clip.x2 || ym + c->r < bmp->clip.y1 || ym - c->r > bmp->clip.y2) \
+			continue; \
+		GROW_BOUNDS(MAX(xm - c->r, bmp->clip.x1), MAX(ym - c->r, bmp->clip.y1), \
+			MIN(xm + c->r, bmp->clip.x2), MIN(ym + c->r, bmp->clip.y2)); \
+		do \
+		{ \
+			BATCH_PLOT(mode, xm - x, ym + y); \
+			BATCH_PLOT(mode, xm - y, ym - x); \
+			BATCH_PLOT(mode, xm + x, ym - y); \
+			BATCH_PLOT(mode, xm + y, ym + x); \
+			e = err; \
+			if (e <= y) err += ++y * 2 + 1; \
+			if (e > x || err > y) err += ++x * 2 + 1; \
+		} \
+		while (x < 0); \
+	}
+	BLEND_DISPATCH(bmp->blendMode, DRAW_CIRCLES);
+#undef DRAW_CIRCLES
+	markDirty(bmp, xl, yl, xr, yr);
+}
+
+// Filled disks of pixels with dx^2 + dy^2 <= r^2, one clipped span per row.
+// Half width is adjusted incrementally from row to row.
+void SDL_ContextBitmapFillCircles(SDL_ContextBitmap* bmp, const SDL_ContextCircle circles[], int count, uint32_t val)
+{
+	register const SDL_ContextCircle* restrict c = circles, *end = circles + count;
+	register uint32_t* restrict row;
+	register int w, y, dy;
+	int xm, ym, y1, y2, rr, xa, xb, xl = INT_MAX, xr = INT_MIN, yl = INT_MAX, yr = INT_MIN;
+#define FILL_CIRCLES(mode) \
+	for (; c < end; ++c) \
+	{ \
+		xm = c->x, ym = c->y; \
+		if (c->r < 0 || xm + c->r < bmp->clip.x1 || xm - c->r > bmp->clip.x2 || ym + c->r < bmp->clip.y1 || ym - c->r > bmp->clip.y2) \
+			continue; \
+		y1 = MAX(ym - c->r, bmp->clip.y1), y2 = MIN(ym + c->r, bmp->clip.y2), rr = c->r * c->r, w = 0; \
+		GROW_BOUNDS(MAX(xm - c->r, bmp->clip.x1), y1, MIN(xm + c->r, bmp->clip.x2), y2); \
+		for (y = y1, row = bmp->pixels + y1 * STRIDE(bmp); y <= y2; ++y, row += STRIDE(bmp)) \
+		{ \
+			dy = y - ym; \
+			while ((w + 1) * (w + 1) + dy * dy <= rr) ++w; \
+			while (w * w + dy * dy > rr) --w; \
+			xa = MAX(xm - w, bmp->clip.x1), xb = MIN(xm + w, bmp->clip.x2); \
+			if (xa <= xb) fillSpan##mode(row + xa, xb - xa + 1, val, bmp->mask); \
+		} \
 	}
-	else if (y1 == y2) // draw top flat triangle
+	BLEND_DISPATCH(bmp->blendMode, FILL_CIRCLES);
+#undef FILL_CIRCLES
+	markDirty(bmp, xl, yl, xr, yr);
+}
+
+#undef BATCH_PLOT
+#undef BATCH_VSPAN
+#undef BATCH_HSPAN
+#undef GROW_BOUNDS
+
+static inline long long floorDiv(long long a, long long b)
+{
+	return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+// Half-space triangle rasterizer. Pixel centers are tested against three edge
+// functions with top-left fill rule, so triangles sharing an edge never draw
+// the same pixel twice. One clipped span is emitted per row.
+void SDL_ContextBitmapFillTriangle(SDL_ContextBitmap* bmp, int x1, int y1, int x2, int y2, int x3, int y3, uint32_t val)
+{
+	// make winding positive, inside is where all edge functions >= 0
+	const long long area = (long long)(x2 - x1) * (y3 - y1) - (long long)(y2 - y1) * (x3 - x1);
+	if (area == 0)
+		return;
+	if (area < 0)
 	{
-		register const float invslope1 = (float)(x3 - x1) / (float)(y3 - y1);
-		register const float invslope2 = (float)(x3 - x2) / (float)(y3 - y2);
-	
-		register float curx1 = x3, curx2 = x3;
-	
-		for (register int y = y3; y >= y1; --y)
-		{
-			SDL_ContextBitmapDrawLine(bmp, curx1, y, curx2, y, val);
-			curx1 -= invslope1, curx2 -= invslope2;
-		}	
+		SWAP(x2, x3);
+		SWAP(y2, y3);
 	}
-	else // draw arbitary triangle
+
+	const int ya = MAX(MIN(y1, MIN(y2, y3)), bmp->clip.y1), yb = MIN(MAX(y1, MAX(y2, y3)), bmp->clip.y2);
+	const int xa = MAX(MIN(x1, MIN(x2, x3)), bmp->clip.x1), xb = MIN(MAX(x1, MAX(x2, x3)), bmp->clip.x2);
+	if (ya > yb || xa > xb)
+		return;
+	markDirty(bmp, xa, ya, xb, yb);
+
+	// edge i goes from vertex i to vertex i + 1, bias excludes pixels on
+	// edges which are not top or left
+	const int vx[3] = { x1, x2, x3 }, vy[3] = { y1, y2, y3 };
+	long long dx[3], dy[3], bias[3];
+	for (register int i = 0; i < 3; ++i)
 	{
-		const int x4 = (int)(x1 + ((float)(y2 - y1) / (float)(y3 - y1)) * (x3 - x1));
-		register float invslope1, invslope2, curx1, curx2;
+		dx[i] = vx[(i + 1) % 3] - vx[i];
+		dy[i] = vy[(i + 1) % 3] - vy[i];
+		bias[i] = dy[i] < 0 || (dy[i] == 0 && dx[i] > 0) ? 0 : 1;
+	}
 
-		invslope1 = (float)(x2 - x1) / (float)(y2 - y1);
-		invslope2 = (float)(x4 - x1) / (float)(y2 - y1);
-	
-		curx1 = curx2 = x1;
-	
-		for (register int y = y1; y <= y2; ++y)
-		{
-			SDL_ContextBitmapDrawLine(bmp, curx1, y, curx2, y, val);
-			curx1 += invslope1, curx2 += invslope2;
-		}
-		
-		invslope1 = (float)(x3 - x2) / (float)(y3 - y2);
-		invslope2 = (float)(x3 - x4) / (float)(y3 - y2);
-	
-		curx1 = curx2 = x3;
-	
-		for (register int y = y3; y > y2; --y)
-		{
-			SDL_ContextBitmapDrawLine(bmp, curx1, y, curx2, y, val);
-			curx1 -= invslope1, curx2 -= invslope2;
-		}	
+	register long long l, r, e;
+	register uint32_t* restrict row = bmp->pixels + ya * STRIDE(bmp);
+
+	// edge function is dx * (y - vy) - dy * (x - vx), linear in x on a row
+#define TRIANGLE(mode) \
+	for (register int y = ya; y <= yb; ++y, row += STRIDE(bmp)) \
+	{ \
+		l = xa, r = xb; \
+		for (register int i = 0; i < 3; ++i) \
+		{ \
+			e = dx[i] * (y - vy[i]) + dy[i] * vx[i]; \
+			if (dy[i] < 0) l = MAX(l, -floorDiv(e - bias[i], -dy[i])); \
+			else if (dy[i] > 0) r = MIN(r, floorDiv(e - bias[i], dy[i])); \
+			else if (e < bias[i]) r = l - 1; \
+		} \
+		if (l <= r) fillSpan##mode(row + l, r - l + 1, val, bmp->mask); \
 	}
+	BLEND_DISPATCH(bmp->blendMode, TRIANGLE);
+#undef TRIANGLE
 }
 
+//
+// Indexed bitmaps
+//
+
+#include "SDL_ContextIndexed.c"
+
+//
+// Compiled sprites
+//
+
+#include "SDL_ContextSprite.c"
+
+//
+// Sprite atlases
+//
+
+#include "SDL_ContextAtlas.c"
+
+//
+// Bitmap fonts
+//
+
+#include "SDL_ContextFont.c"
+
+//
+// Tilemaps
+//
+
+#include "SDL_ContextTilemap.c"
+
+//
+// Sprite batches
+//
+
+#include "SDL_ContextBatch.c"
+
+//
+// Collision masks
+//
+
+#include "SDL_ContextCollision.c"
+
 #endif // SDL_CONTEXT_NO_GRAPHICS
 
 #ifndef SDL_CONTEXT_NO_AUDIO
@@ -10,6 +10,11 @@
  *  - SDL_CONTEXT_GLOBAL_CACHES - make input caches global. If SDL_CONTEXT_NO_INPUT not defined does nothing.
  *  - SDL_CONTEXT_NO_AUDIO - disable context audio implementation.
  *  - SDL_CONTEXT_LUA - plug lua.
+ *  - SDL_CONTEXT_NO_SIMD - disable SSE2/AVX2 span kernels.
+ *  - SDL_CONTEXT_STREAM_BYTES - size of cleared block from which non-temporal stores are used.
+ *  - SDL_CONTEXT_PARALLEL_PIXELS - number of pixels from which bulk operations are split among threads.
+ *  - SDL_CONTEXT_FONT_CACHE - number of laid out strings cached per font.
+ *  - SDL_CONTEXT_TILEMAP_CHUNK - side of tilemap chunk drawn into one cached bitmap, in tiles.
  */
 
 #ifndef __SDL_CONTEXT_H__
@@ -68,18 +73,69 @@ SDL_ContextAudio;
 
 #define SDL_BLENDMODE_MASK 4
 
+// dirty rectangles kept per bitmap, more are merged
+#ifndef SDL_CONTEXT_DIRTY_RECTS
+#define SDL_CONTEXT_DIRTY_RECTS (8)
+#endif
+
 typedef struct SDL_ContextBitmap
 {
 	uint32_t* pixels;
 	struct { int x1, y1, x2, y2, w, h; } clip;
-	int width, height, pitch;
+	struct { SDL_Rect rects[SDL_CONTEXT_DIRTY_RECTS]; int count; bool track; } dirty; // written areas
+	int width, height, pitch; // pitch is bytes from a row to the next one, rows may be padded
 	float tx, ty; // translation
 	uint32_t mask;
 	uint8_t blendMode;
 	bool shared;
+	bool premultiplied; // color channels are multiplied by alpha, blended as src + dest * (1 - a)
 }
 SDL_ContextBitmap;
 
+typedef struct SDL_ContextIndexedBitmap
+{
+	uint8_t* pixels; // indices into palette
+	struct { int x1, y1, x2, y2, w, h; } clip;
+	int width, height, pitch; // pitch is bytes (indices) from a row to the next one
+	int key; // index skipped by copies, -1 for none
+	uint32_t palette[256];
+}
+SDL_ContextIndexedBitmap;
+
+// circle of batched circle draws, each has its own radius
+typedef struct SDL_ContextCircle
+{
+	int x, y, r;
+}
+SDL_ContextCircle;
+
+typedef struct SDL_ContextSpriteRun
+{
+	int x, n;   // first column and length
+	int offset; // first pixel in sprite pixels
+	bool blend; // translucent pixels, opaque ones are copied
+}
+SDL_ContextSpriteRun;
+
+typedef struct SDL_ContextSprite
+{
+	SDL_ContextSpriteRun* runs;
+	int* rows; // runs of row y are runs[rows[y]..rows[y + 1] - 1]
+	uint32_t* pixels;
+	struct { int x1, y1, x2, y2; } bounds; // non-transparent area, empty when x1 > x2
+	int width, height;
+	bool premultiplied;
+}
+SDL_ContextSprite;
+
+typedef struct SDL_ContextCollisionMask
+{
+	uint64_t* bits; // word w of row y is bits[w * height + y], bit i is column w * 64 + i
+	int width, height, words;
+	struct { int x1, y1, x2, y2; } bounds; // solid area, empty when x1 > x2
+}
+SDL_ContextCollisionMask;
+
 #endif // SDL_CONTEXT_NO_GRAPHICS
 
 //
@@ -93,8 +149,14 @@ typedef struct SDL_Context
 #ifndef SDL_CONTEXT_RENDER_SOFTWARE
 	SDL_Renderer* renderer;
 	SDL_Texture* texture;
+	// Own frame buffer pixels while it is locked texture memory, NULL otherwise
+	uint32_t* pixels;
 #else // SDL_CONTEXT_RENDER_SOFTWARE
 	SDL_Surface* surface;
+	// Presents previous frame while next is drawn, NULL when single buffered
+	struct SDL_ContextPresenter* presenter;
+	// Indexed frame buffer is expanded here when single buffered, NULL until used
+	uint32_t* expanded;
 #endif // SDL_CONTEXT_RENDER_SOFTWARE
 	// User callbacks
 	bool (*update)(struct SDL_Context* ctx, float dt);
@@ -103,6 +165,10 @@ typedef struct SDL_Context
 #ifndef SDL_CONTEXT_NO_GRAPHICS
 	// Frame buffer
 	SDL_ContextBitmap* bitmap;
+	// Recorded draw commands, NULL when drawing immediately
+	struct SDL_ContextCommandBuffer* commands;
+	// Presented through its palette instead of bitmap when set, not owned
+	SDL_ContextIndexedBitmap* indexed;
 #endif // SDL_CONTEXT_NO_GRAPHICS
 	unsigned short scaleX, scaleY;
 #ifndef SDL_CONTEXT_NO_AUDIO
@@ -124,6 +190,7 @@ SDL_Context;
 // getters
 #ifndef SDL_CONTEXT_NO_GRAPHICS
 #define SDL_ContextGetFramebuffer(ctx) ((SDL_ContextBitmap* const)(ctx)->bitmap)
+#define SDL_ContextGetCurrentBuffer(ctx) SDL_ContextGetFramebuffer(ctx)
 #define SDL_ContextGetWidth(ctx) ((const int)SDL_ContextGetCurrentBuffer(ctx)->width)
 #define SDL_ContextGetHeight(ctx) ((const int)SDL_ContextGetCurrentBuffer(ctx)->height)
 #else // SDL_CONTEXT_NO_GRAPHICS
@@ -158,6 +225,21 @@ void SDL_ContextMainLoop(SDL_Context* ctx, unsigned short frameCap);
 void SDL_ContextMainLoopFixed(SDL_Context* ctx, unsigned short frameCap);
 void SDL_ContextMainLoopFixe(SDL_Context* ctx, unsigned short frameCap);
 void SDL_DestroyContext(SDL_Context* ctx);
+
+typedef enum
+{
+	SDL_CONTEXT_SINGLE_BUFFER, // frame buffer is presented at swap, it keeps its content
+	SDL_CONTEXT_DOUBLE_BUFFER, // frame is scaled while the next one is drawn and shown at next swap
+	SDL_CONTEXT_STREAMING_BUFFER // frame is drawn straight into locked texture memory
+}
+SDL_ContextBuffering;
+
+// Double buffering is for software rendering only, streaming for accelerated
+// rendering only. In both frame buffer pixels (and pitch) change at every
+// swap. Double buffered content is kept, streamed content is not, so whole
+// frame must be drawn every frame.
+void SDL_ContextSetBuffering(SDL_Context* ctx, SDL_ContextBuffering mode);
+
 void SDL_ContextSwapBuffers(SDL_Context* ctx);
 #define SDL_ContextCopyBuffer(ctx) SDL_ContextSwapBuffers(ctx)
 
@@ -221,6 +303,20 @@ int SDL_ContextGetMouseY(const SDL_Context* ctx);
 
 #endif // SDL_CONTEXT_NO_INPUT
 
+//
+// Thread pool
+//
+
+// count <= 0 starts one worker less than CPU count, returns number of workers
+int SDL_ContextStartThreads(int count);
+void SDL_ContextStopThreads(void);
+int SDL_ContextGetThreadCount(void);
+
+// Call func on row bands [y1, y2) of y1..y2 in parallel, width is the
+// number of pixels in a row, small areas are processed by a single call.
+typedef void (*SDL_ContextRowsFunc)(void* data, int y1, int y2);
+void SDL_ContextParallelRows(int y1, int y2, int width, SDL_ContextRowsFunc func, void* data);
+
 #ifndef SDL_CONTEXT_NO_GRAPHICS
 
 //
@@ -245,6 +341,8 @@ SDL_ContextBitmap* SDL_ContextCreateBitmapShared(uint32_t pixels[], int width, i
 SDL_ContextBitmap* SDL_ContextCloneBitmap(const SDL_ContextBitmap* bmp);
 SDL_ContextBitmap* SDL_ContextLoadBitmap(const char* path);
 SDL_ContextBitmap* SDL_ContextLoadBitmapWithTransparent(const char* path, uint32_t transparent);
+SDL_ContextBitmap* SDL_ContextLoadBitmapPremultiplied(const char* path);
+void SDL_ContextBitmapPremultiply(SDL_ContextBitmap* bmp);
 void SDL_ContextDestroyBitmap(SDL_ContextBitmap* bmp);
 void SDL_ContextBitmapCopy(SDL_ContextBitmap* dest, const SDL_ContextBitmap* src, int x, int y);
 void SDL_ContextBitmapCopyEx(SDL_ContextBitmap* dest, const SDL_ContextBitmap* src, int x, int y, int sx, int sy, SDL_ContextTransform transform);
@@ -257,6 +355,8 @@ void SDL_ContextBitmapDrawBitmap(SDL_ContextBitmap* restrict dest, const SDL_Con
 #define SDL_ContextBitmapSetMask(bmp, m) do { (bmp)->mask = (m); } while (0)
 void SDL_ContextBitmapClip(SDL_ContextBitmap* bmp, int x, int y, int w, int h);
 uint32_t SDL_ContextBitmapGetPixel(const SDL_ContextBitmap* bmp, int x, int y);
+void SDL_ContextBitmapMarkDirty(SDL_ContextBitmap* bmp, int x, int y, int w, int h);
+#define SDL_ContextBitmapTrackDirty(bmp, on) do { (bmp)->dirty.track = (on), (bmp)->dirty.count = 0; } while (0)
 void SDL_ContextBitmapClear(SDL_ContextBitmap* restrict bmp, uint32_t val);
 void SDL_ContextBitmapDrawPoint(SDL_ContextBitmap* bmp, int x, int y, uint32_t val);
 void SDL_ContextBitmapDrawLine(SDL_ContextBitmap* bmp, int x1, int y1, int x2, int y2, uint32_t val);
@@ -266,12 +366,188 @@ void SDL_ContextBitmapDrawCircle(SDL_ContextBitmap* bmp, int x, int y, int r, ui
 void SDL_ContextBitmapFillCircle(SDL_ContextBitmap* bmp, int x, int y, int r, uint32_t val);
 void SDL_ContextBitmapDrawTriangle(SDL_ContextBitmap* bmp, int x1, int y1, int x2, int y2, int x3, int y3, uint32_t val);
 void SDL_ContextBitmapFillTriangle(SDL_ContextBitmap* bmp, int x1, int y1, int x2, int y2, int x3, int y3, uint32_t val);
+void SDL_ContextBitmapDrawPoints(SDL_ContextBitmap* bmp, const SDL_Point points[], int count, uint32_t val);
+void SDL_ContextBitmapDrawLines(SDL_ContextBitmap* bmp, const SDL_Point points[], int count, uint32_t val);
+void SDL_ContextBitmapDrawRects(SDL_ContextBitmap* bmp, const SDL_Rect rects[], int count, uint32_t val);
+void SDL_ContextBitmapFillRects(SDL_ContextBitmap* bmp, const SDL_Rect rects[], int count, uint32_t val);
+void SDL_ContextBitmapDrawCircles(SDL_ContextBitmap* bmp, const SDL_ContextCircle circles[], int count, uint32_t val);
+void SDL_ContextBitmapFillCircles(SDL_ContextBitmap* bmp, const SDL_ContextCircle circles[], int count, uint32_t val);
+
+//
+// Compiled sprites
+//
+
+// compiles clip area of bmp, pixels with zero alpha are left out
+SDL_ContextSprite* SDL_ContextCompileSprite(const SDL_ContextBitmap* bmp);
+void SDL_ContextDestroySprite(SDL_ContextSprite* spr);
+void SDL_ContextBitmapCopySprite(SDL_ContextBitmap* dest, const SDL_ContextSprite* spr, int x, int y);
+
+//
+// Sprite atlases
+//
+
+typedef struct SDL_ContextAtlas SDL_ContextAtlas;
+
+// atlas owns sheet, regions are selected by handles returned on adding
+SDL_ContextAtlas* SDL_ContextCreateAtlas(SDL_ContextBitmap* sheet);
+SDL_ContextAtlas* SDL_ContextPackAtlas(const SDL_ContextBitmap* const bitmaps[], const char* const names[], int count, int width);
+SDL_ContextAtlas* SDL_ContextLoadAtlas(const char* const paths[], int count, int width);
+void SDL_ContextDestroyAtlas(SDL_ContextAtlas* atlas);
+int SDL_ContextAtlasAddRegion(SDL_ContextAtlas* atlas, const char* name, int x, int y, int w, int h);
+int SDL_ContextAtlasFind(const SDL_ContextAtlas* atlas, const char* name);
+int SDL_ContextAtlasCount(const SDL_ContextAtlas* atlas);
+SDL_ContextBitmap* SDL_ContextAtlasGetSheet(const SDL_ContextAtlas* atlas);
+// Read-only view of region, usable as source of every copy function. Valid
+// until next region is added. NULL for invalid handle (e.g. -1 from failed add).
+const SDL_ContextBitmap* SDL_ContextAtlasGet(const SDL_ContextAtlas* atlas, int handle);
+
+//
+// Bitmap fonts
+//
+
+typedef struct SDL_ContextFont SDL_ContextFont;
+
+// Font owns sheet, its width x height cells are glyphs of codes first, first + 1, ...
+// NULL for missing sheet or cells without area, sheet is destroyed then too
+SDL_ContextFont* SDL_ContextCreateFont(SDL_ContextBitmap* sheet, int width, int height, int first);
+SDL_ContextFont* SDL_ContextLoadFont(const char* path, int width, int height, int first, uint32_t transparent);
+void SDL_ContextDestroyFont(SDL_ContextFont* font);
+void SDL_ContextFontMeasure(const SDL_ContextFont* font, const char* text, int* w, int* h);
+// text is multiplied by color, '\n' starts a new line
+void SDL_ContextBitmapDrawText(SDL_ContextBitmap* dest, SDL_ContextFont* font, const char* text, int x, int y, uint32_t color);
+
+//
+// Tilemaps
+//
+
+typedef struct SDL_ContextTilemap SDL_ContextTilemap;
+
+// Cells are handles of tiles atlas (not owned), all tileWidth x tileHeight, -1 is empty
+SDL_ContextTilemap* SDL_ContextCreateTilemap(const SDL_ContextAtlas* tiles, int width, int height, int tileWidth, int tileHeight);
+void SDL_ContextDestroyTilemap(SDL_ContextTilemap* map);
+void SDL_ContextTilemapSet(SDL_ContextTilemap* map, int x, int y, int tile);
+void SDL_ContextTilemapSetCells(SDL_ContextTilemap* map, const int cells[]);
+int SDL_ContextTilemapGet(const SDL_ContextTilemap* map, int x, int y);
+void SDL_ContextTilemapInvalidate(SDL_ContextTilemap* map);
+// x, y is position of map's top left corner, dest is left as it is under empty cells
+void SDL_ContextBitmapDrawTilemap(SDL_ContextBitmap* dest, SDL_ContextTilemap* map, int x, int y);
+
+//
+// Sprite batches
+//
+
+typedef struct SDL_ContextBatch SDL_ContextBatch;
+
+typedef struct
+{
+	int sprites;
+	int batches;       // runs of draws with same source and blend mode
+	int sourceChanges;
+	int blendChanges;
+}
+SDL_ContextBatchStats;
+
+SDL_ContextBatch* SDL_ContextCreateBatch(void);
+void SDL_ContextDestroyBatch(SDL_ContextBatch* batch);
+// blend mode of draws added after this call, SDL_BLENDMODE_BLEND by default
+void SDL_ContextBatchSetBlend(SDL_ContextBatch* batch, uint8_t mode);
+// Lower layers are drawn first, draws of one layer and source keep their order.
+// Sources are kept by pointer until the batch is drawn.
+void SDL_ContextBatchCopy(SDL_ContextBatch* batch, int layer, const SDL_ContextBitmap* src, int x, int y);
+void SDL_ContextBatchCopyEx(SDL_ContextBatch* batch, int layer, const SDL_ContextBitmap* src, int x, int y, int sx, int sy, SDL_ContextTransform transform);
+void SDL_ContextBatchBitmap(SDL_ContextBatch* batch, int layer, const SDL_ContextBitmap* src, int x, int y, float a, int ox, int oy, float sclx, float scly);
+void SDL_ContextBatchSprite(SDL_ContextBatch* batch, int layer, const SDL_ContextSprite* spr, int x, int y);
+void SDL_ContextBatchClear(SDL_ContextBatch* batch);
+// counted by last draw of the batch
+SDL_ContextBatchStats SDL_ContextBatchGetStats(const SDL_ContextBatch* batch);
+// draws sorted batch and empties it
+void SDL_ContextBitmapDrawBatch(SDL_ContextBitmap* dest, SDL_ContextBatch* batch);
+
+//
+// Collision masks
+//
+
+// Pixels of clip area with alpha above threshold are solid
+SDL_ContextCollisionMask* SDL_ContextCreateCollisionMask(const SDL_ContextBitmap* bmp, uint8_t threshold);
+void SDL_ContextDestroyCollisionMask(SDL_ContextCollisionMask* mask);
+bool SDL_ContextCollisionMaskGet(const SDL_ContextCollisionMask* mask, int x, int y);
+// true if solid pixels of a placed at ax, ay and b placed at bx, by overlap
+bool SDL_ContextCollisionMaskOverlap(const SDL_ContextCollisionMask* a, int ax, int ay, const SDL_ContextCollisionMask* b, int bx, int by);
+
+//
+// Indexed bitmaps
+//
+
+SDL_ContextIndexedBitmap* SDL_ContextCreateIndexed(int width, int height);
+SDL_ContextIndexedBitmap* SDL_ContextLoadIndexed(const char* path);
+void SDL_ContextDestroyIndexed(SDL_ContextIndexedBitmap* bmp);
+void SDL_ContextIndexedSetPalette(SDL_ContextIndexedBitmap* bmp, const uint32_t colors[], int first, int count);
+void SDL_ContextIndexedCyclePalette(SDL_ContextIndexedBitmap* bmp, int first, int count, int shift);
+#define SDL_ContextIndexedSetKey(bmp, index) do { (bmp)->key = (index); } while (0)
+void SDL_ContextIndexedExpand(const SDL_ContextIndexedBitmap* bmp, uint32_t pixels[], int pitch);
+void SDL_ContextBitmapCopyIndexed(SDL_ContextBitmap* dest, const SDL_ContextIndexedBitmap* src, int x, int y);
+void SDL_ContextIndexedClip(SDL_ContextIndexedBitmap* bmp, int x, int y, int w, int h);
+uint8_t SDL_ContextIndexedGetPixel(const SDL_ContextIndexedBitmap* bmp, int x, int y);
+void SDL_ContextIndexedClear(SDL_ContextIndexedBitmap* bmp, uint8_t index);
+void SDL_ContextIndexedDrawPoint(SDL_ContextIndexedBitmap* bmp, int x, int y, uint8_t index);
+void SDL_ContextIndexedDrawLine(SDL_ContextIndexedBitmap* bmp, int x1, int y1, int x2, int y2, uint8_t index);
+void SDL_ContextIndexedDrawRect(SDL_ContextIndexedBitmap* bmp, int x, int y, int w, int h, uint8_t index);
+void SDL_ContextIndexedFillRect(SDL_ContextIndexedBitmap* bmp, int x, int y, int w, int h, uint8_t index);
+void SDL_ContextIndexedFillCircle(SDL_ContextIndexedBitmap* bmp, int x, int y, int r, uint8_t index);
+void SDL_ContextIndexedCopy(SDL_ContextIndexedBitmap* dest, const SDL_ContextIndexedBitmap* src, int x, int y);
+
+// Present bmp instead of the frame buffer, it is expanded to
+// SDL_CONTEXT_PIXELFORMAT at SDL_ContextSwapBuffers. Must have frame buffer
+// size, NULL switches back. Frame buffer keeps what was drawn into it, except
+// with streaming buffering where it is texture memory anyway.
+void SDL_ContextSetIndexedFramebuffer(SDL_Context* ctx, SDL_ContextIndexedBitmap* bmp);
+
+//
+// Command buffer
+//
+
+typedef enum SDL_ContextCommandFlags
+{
+	SDL_COMMANDS_RECORD = 0,
+	SDL_COMMANDS_SORT = 0x01, // group commands with the same source and blend mode
+	SDL_COMMANDS_CULL = 0x02, // drop commands which are overdrawn by later opaque ones
+	SDL_COMMANDS_TILED = 0x04 // draw screen tiles on the thread pool
+}
+SDL_ContextCommandFlags;
+
+// While recording, SDL_ContextDraw*, SDL_ContextFill*, SDL_ContextClear and
+// SDL_ContextCopy* are stored and executed at SDL_ContextSwapBuffers. Batches
+// and SDL_ContextGetPixel flush pending commands and run immediately.
+void SDL_ContextBeginCommands(SDL_Context* ctx, uint32_t flags);
+void SDL_ContextEndCommands(SDL_Context* ctx);
+void SDL_ContextFlushCommands(SDL_Context* ctx);
+void SDL_ContextReplayCommands(SDL_Context* ctx);
+void SDL_ContextRecordClear(SDL_Context* ctx, uint32_t val);
+void SDL_ContextRecordPoint(SDL_Context* ctx, int x, int y, uint32_t val);
+void SDL_ContextRecordLine(SDL_Context* ctx, int x1, int y1, int x2, int y2, uint32_t val);
+void SDL_ContextRecordRect(SDL_Context* ctx, int x, int y, int w, int h, uint32_t val);
+void SDL_ContextRecordFillRect(SDL_Context* ctx, int x, int y, int w, int h, uint32_t val);
+void SDL_ContextRecordCircle(SDL_Context* ctx, int x, int y, int r, uint32_t val);
+void SDL_ContextRecordFillCircle(SDL_Context* ctx, int x, int y, int r, uint32_t val);
+void SDL_ContextRecordTriangle(SDL_Context* ctx, int x1, int y1, int x2, int y2, int x3, int y3, uint32_t val);
+void SDL_ContextRecordFillTriangle(SDL_Context* ctx, int x1, int y1, int x2, int y2, int x3, int y3, uint32_t val);
+void SDL_ContextRecordCopy(SDL_Context* ctx, const SDL_ContextBitmap* src, int x, int y);
+void SDL_ContextRecordCopyEx(SDL_Context* ctx, const SDL_ContextBitmap* src, int x, int y, int sx, int sy, SDL_ContextTransform transform);
+void SDL_ContextRecordBitmap(SDL_Context* ctx, const SDL_ContextBitmap* src, int x, int y, float a, int ox, int oy, float sclx, float scly);
+void SDL_ContextRecordSprite(SDL_Context* ctx, const SDL_ContextSprite* spr, int x, int y);
+void SDL_ContextRecordText(SDL_Context* ctx, SDL_ContextFont* font, const char* text, int x, int y, uint32_t color);
+void SDL_ContextRecordTilemap(SDL_Context* ctx, SDL_ContextTilemap* map, int x, int y);
+void SDL_ContextRecordBatch(SDL_Context* ctx, SDL_ContextBatch* batch);
+
+// select recording or immediate drawing
+#define SDL_CONTEXT_DRAW(ctx, record, draw, ...) \
+	((ctx)->commands ? record((ctx), __VA_ARGS__) : draw((ctx)->bitmap, __VA_ARGS__))
 
 //
 // Bindings for SDL_Context
 //
 
-#define SDL_ContextClear(ctx, val) SDL_ContextBitmapClear((ctx)->bitmap, val)
+#define SDL_ContextClear(ctx, val) SDL_CONTEXT_DRAW(ctx, SDL_ContextRecordClear, SDL_ContextBitmapClear, val)
 #define SDL_ContextTranslate(ctx, tx, ty) SDL_ContextBitmapTranslate((ctx)->bitmap, (tx), (ty))
 #define SDL_ContextTranslateX(ctx, tx) SDL_ContextBitmapTranslateX((ctx)->bitmap, (tx))
 #define SDL_ContextTranslateY(ctx, ty) SDL_ContextBitmapTranslateY((ctx)->bitmap, (ty))
@@ -279,16 +555,34 @@ void SDL_ContextBitmapFillTriangle(SDL_ContextBitmap* bmp, int x1, int y1, int x
 #define SDL_ContextSetBlend(ctx, mode) SDL_ContextBitmapSetBlend((ctx)->bitmap, (mode))
 #define SDL_ContextSetMask(ctx, m) SDL_ContextBitmapSetMask((ctx)->bitmap, (m))
 #define SDL_ContextClip(ctx, ...) SDL_ContextBitmapClip((ctx)->bitmap, __VA_ARGS__)
-#define SDL_ContextGetPixel(ctx, ...) SDL_ContextBitmapGetPixel((ctx)->bitmap, __VA_ARGS__)
-#define SDL_ContextDrawPoint(ctx, ...) SDL_ContextBitmapDrawPoint((ctx)->bitmap, __VA_ARGS__)
-#define SDL_ContextDrawLine(ctx, ...) SDL_ContextBitmapDrawLine((ctx)->bitmap, __VA_ARGS__)
-#define SDL_ContextDrawRect(ctx, ...) SDL_ContextBitmapDrawRect((ctx)->bitmap, __VA_ARGS__)
-#define SDL_ContextFillRect(ctx, ...) SDL_ContextBitmapFillRect((ctx)->bitmap, __VA_ARGS__)
-#define SDL_ContextDrawCircle(ctx, ...) SDL_ContextBitmapDrawCircle((ctx)->bitmap, __VA_ARGS__)
-#define SDL_ContextFillCircle(ctx, ...) SDL_ContextBitmapFillCircle((ctx)->bitmap, __VA_ARGS__)
-#define SDL_ContextDrawTriangle(ctx, ...) SDL_ContextBitmapDrawTriangle((ctx)->bitmap, __VA_ARGS__)
-#define SDL_ContextFillTriangle(ctx, ...) SDL_ContextBitmapFillTriangle((ctx)->bitmap, __VA_ARGS__)
-#define SDL_ContextDrawBitmap(ctx, ...) SDL_ContextBitmapDrawBitmap(SDL_ContextGetCurrentBuffer(ctx), __VA_ARGS__)
+#define SDL_ContextMarkDirty(ctx, ...) SDL_ContextBitmapMarkDirty((ctx)->bitmap, __VA_ARGS__)
+#define SDL_ContextGetPixel(ctx, ...) (SDL_ContextFlushCommands(ctx), SDL_ContextBitmapGetPixel((ctx)->bitmap, __VA_ARGS__))
+#define SDL_ContextDrawPoint(ctx, ...) SDL_CONTEXT_DRAW(ctx, SDL_ContextRecordPoint, SDL_ContextBitmapDrawPoint, __VA_ARGS__)
+#define SDL_ContextDrawLine(ctx, ...) SDL_CONTEXT_DRAW(ctx, SDL_ContextRecordLine, SDL_ContextBitmapDrawLine, __VA_ARGS__)
+#define SDL_ContextDrawRect(ctx, ...) SDL_CONTEXT_DRAW(ctx, SDL_ContextRecordRect, SDL_ContextBitmapDrawRect, __VA_ARGS__)
+#define SDL_ContextFillRect(ctx, ...) SDL_CONTEXT_DRAW(ctx, SDL_ContextRecordFillRect, SDL_ContextBitmapFillRect, __VA_ARGS__)
+#define SDL_ContextDrawCircle(ctx, ...) SDL_CONTEXT_DRAW(ctx, SDL_ContextRecordCircle, SDL_ContextBitmapDrawCircle, __VA_ARGS__)
+#define SDL_ContextFillCircle(ctx, ...) SDL_CONTEXT_DRAW(ctx, SDL_ContextRecordFillCircle, SDL_ContextBitmapFillCircle, __VA_ARGS__)
+#define SDL_ContextDrawTriangle(ctx, ...) SDL_CONTEXT_DRAW(ctx, SDL_ContextRecordTriangle, SDL_ContextBitmapDrawTriangle, __VA_ARGS__)
+#define SDL_ContextFillTriangle(ctx, ...) SDL_CONTEXT_DRAW(ctx, SDL_ContextRecordFillTriangle, SDL_ContextBitmapFillTriangle, __VA_ARGS__)
+#define SDL_ContextDrawPoints(ctx, ...) (SDL_ContextFlushCommands(ctx), SDL_ContextBitmapDrawPoints((ctx)->bitmap, __VA_ARGS__))
+#define SDL_ContextDrawLines(ctx, ...) (SDL_ContextFlushCommands(ctx), SDL_ContextBitmapDrawLines((ctx)->bitmap, __VA_ARGS__))
+#define SDL_ContextDrawRects(ctx, ...) (SDL_ContextFlushCommands(ctx), SDL_ContextBitmapDrawRects((ctx)->bitmap, __VA_ARGS__))
+#define SDL_ContextFillRects(ctx, ...) (SDL_ContextFlushCommands(ctx), SDL_ContextBitmapFillRects((ctx)->bitmap, __VA_ARGS__))
+#define SDL_ContextDrawCircles(ctx, ...) (SDL_ContextFlushCommands(ctx), SDL_ContextBitmapDrawCircles((ctx)->bitmap, __VA_ARGS__))
+#define SDL_ContextFillCircles(ctx, ...) (SDL_ContextFlushCommands(ctx), SDL_ContextBitmapFillCircles((ctx)->bitmap, __VA_ARGS__))
+#define SDL_ContextCopy(ctx, ...) SDL_CONTEXT_DRAW(ctx, SDL_ContextRecordCopy, SDL_ContextBitmapCopy, __VA_ARGS__)
+#define SDL_ContextCopyEx(ctx, ...) SDL_CONTEXT_DRAW(ctx, SDL_ContextRecordCopyEx, SDL_ContextBitmapCopyEx, __VA_ARGS__)
+#define SDL_ContextDrawBitmap(ctx, ...) SDL_CONTEXT_DRAW(ctx, SDL_ContextRecordBitmap, SDL_ContextBitmapDrawBitmap, __VA_ARGS__)
+#define SDL_ContextCopySprite(ctx, ...) SDL_CONTEXT_DRAW(ctx, SDL_ContextRecordSprite, SDL_ContextBitmapCopySprite, __VA_ARGS__)
+#define SDL_ContextDrawText(ctx, ...) SDL_CONTEXT_DRAW(ctx, SDL_ContextRecordText, SDL_ContextBitmapDrawText, __VA_ARGS__)
+#define SDL_ContextDrawTilemap(ctx, ...) SDL_CONTEXT_DRAW(ctx, SDL_ContextRecordTilemap, SDL_ContextBitmapDrawTilemap, __VA_ARGS__)
+#define SDL_ContextDrawBatch(ctx, batch) SDL_CONTEXT_DRAW(ctx, SDL_ContextRecordBatch, SDL_ContextBitmapDrawBatch, batch)
+// invalid handles draw nothing
+#define SDL_ContextCopyRegion(ctx, atlas, handle, ...) \
+	do { const SDL_ContextBitmap* __sdlctx_region__ = SDL_ContextAtlasGet((atlas), (handle)); if (__sdlctx_region__) SDL_ContextCopy(ctx, __sdlctx_region__, __VA_ARGS__); } while (0)
+#define SDL_ContextCopyRegionEx(ctx, atlas, handle, ...) \
+	do { const SDL_ContextBitmap* __sdlctx_region__ = SDL_ContextAtlasGet((atlas), (handle)); if (__sdlctx_region__) SDL_ContextCopyEx(ctx, __sdlctx_region__, __VA_ARGS__); } while (0)
 
 #endif // SDL_CONTEXT_NO_GRAPHICS
 
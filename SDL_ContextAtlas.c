@@ -0,0 +1,193 @@
+/*
+ * Title: SDL_ContextAtlas.c
+ * Autor: @ooichu
+ * Description: Sprite atlases, part of SDL_Context library.
+ * Regions of a sheet are registered once and kept as bitmap views sharing
+ * the sheet pixels with clip already set, so they can be passed to every
+ * copy function (and recorded) without touching the sheet.
+ */
+
+typedef struct
+{
+	SDL_ContextBitmap view; // sheet clipped to region
+	char* name;
+}
+AtlasRegion;
+
+struct SDL_ContextAtlas
+{
+	SDL_ContextBitmap* sheet;
+	dynarr_t(AtlasRegion) regions;
+};
+
+// atlas owns the sheet, NULL sheet (failed load) gives no atlas
+SDL_ContextAtlas* SDL_ContextCreateAtlas(SDL_ContextBitmap* sheet)
+{
+	if (!sheet)
+	{
+		fprintf(stdout, "SDL_Context(%s): No sheet given!\n", __func__);
+		return NULL;
+	}
+
+	SDL_ContextAtlas* atlas = xmalloc(sizeof(SDL_ContextAtlas));
+	atlas->sheet = sheet;
+	dynarr_init(AtlasRegion, atlas->regions);
+	return atlas;
+}
+
+void SDL_ContextDestroyAtlas(SDL_ContextAtlas* atlas)
+{
+	if (!atlas) return;
+	for (register unsigned long i = 0; i < atlas->regions.length; ++i)
+		xfree(atlas->regions.pool[i].name);
+	dynarr_free(atlas->regions);
+	SDL_ContextDestroyBitmap(atlas->sheet);
+	xfree(atlas);
+}
+
+int SDL_ContextAtlasAddRegion(SDL_ContextAtlas* atlas, const char* name, int x, int y, int w, int h)
+{
+	register const SDL_ContextBitmap* const sheet = atlas->sheet;
+	if (w <= 0 || h <= 0 || x < 0 || y < 0 || x + w > sheet->width || y + h > sheet->height)
+	{
+		fprintf(stdout, "SDL_Context(%s): Region is out of sheet!\n", __func__);
+		return -1;
+	}
+
+	if (atlas->regions.length == atlas->regions.allocated)
+	{
+		dynarr_resize(atlas->regions, atlas->regions.allocated ? atlas->regions.allocated * 2 : ALLOCATION_STEP);
+		if (!atlas->regions.pool) PANIC("Cannot allocate memory!");
+	}
+
+	register AtlasRegion* restrict r = atlas->regions.pool + atlas->regions.length;
+	r->view = *sheet;
+	r->view.clip.x1 = x, r->view.clip.y1 = y;
+	r->view.clip.x2 = x + w - 1, r->view.clip.y2 = y + h - 1;
+	r->view.clip.w = w, r->view.clip.h = h;
+	r->view.dirty.count = 0, r->view.dirty.track = false;
+	r->view.shared = true;
+	r->name = NULL;
+	if (name)
+	{
+		r->name = xmalloc(strlen(name) + 1);
+		strcpy(r->name, name);
+	}
+	return atlas->regions.length++;
+}
+
+int SDL_ContextAtlasFind(const SDL_ContextAtlas* atlas, const char* name)
+{
+	for (register unsigned long i = 0; i < atlas->regions.length; ++i)
+		if (atlas->regions.pool[i].name && !strcmp(atlas->regions.pool[i].name, name))
+			return i;
+	return -1;
+}
+
+int SDL_ContextAtlasCount(const SDL_ContextAtlas* atlas)
+{
+	return atlas->regions.length;
+}
+
+const SDL_ContextBitmap* SDL_ContextAtlasGet(const SDL_ContextAtlas* atlas, int handle)
+{
+	if (handle < 0 || (unsigned long)handle >= atlas->regions.length)
+		return NULL;
+	return &atlas->regions.pool[handle].view;
+}
+
+SDL_ContextBitmap* SDL_ContextAtlasGetSheet(const SDL_ContextAtlas* atlas)
+{
+	return atlas->sheet;
+}
+
+//
+// Packing
+//
+
+typedef struct
+{
+	int index, w, h;
+}
+PackItem;
+
+// taller first, shelves waste less
+static int comparePackItems(const void* a, const void* b)
+{
+	register const PackItem* const pa = a, *const pb = b;
+	return pa->h != pb->h ? pb->h - pa->h : pa->index - pb->index;
+}
+
+// Shelf packing: bitmaps go left to right in rows as tall as their first
+// (tallest) bitmap. width <= 0 picks square-ish sheet.
+SDL_ContextAtlas* SDL_ContextPackAtlas(const SDL_ContextBitmap* const bitmaps[], const char* const names[], int count, int width)
+{
+	PackItem* items = xmalloc(MAX(count, 1) * sizeof(PackItem));
+	int* px = xmalloc(MAX(count, 1) * sizeof(int)), *py = xmalloc(MAX(count, 1) * sizeof(int));
+	register int i, x = 0, y = 0, shelf = 0, widest = 1;
+	long long area = 0;
+	bool premultiplied = false;
+
+	for (i = 0; i < count; ++i)
+	{
+		items[i].index = i;
+		items[i].w = bitmaps[i]->clip.w, items[i].h = bitmaps[i]->clip.h;
+		widest = MAX(widest, items[i].w);
+		area += (long long)items[i].w * items[i].h;
+		premultiplied |= bitmaps[i]->premultiplied;
+	}
+	if (width <= 0)
+		width = (int)ceil(sqrt((double)area));
+	width = MAX(width, widest);
+
+	qsort(items, count, sizeof(PackItem), comparePackItems);
+	for (i = 0; i < count; x += items[i++].w)
+	{
+		if (x + items[i].w > width)
+			y += shelf, x = shelf = 0;
+		px[items[i].index] = x, py[items[i].index] = y;
+		shelf = MAX(shelf, items[i].h);
+	}
+
+	SDL_ContextBitmap* sheet = SDL_ContextCreateBitmap(width, MAX(y + shelf, 1));
+	sheet->premultiplied = premultiplied;
+	SDL_ContextAtlas* atlas = SDL_ContextCreateAtlas(sheet);
+	for (i = 0; i < count; ++i)
+	{
+		register const SDL_ContextBitmap* const b = bitmaps[i];
+		register const uint32_t* restrict s = b->pixels + b->clip.x1 + b->clip.y1 * STRIDE(b);
+		register uint32_t* restrict d = sheet->pixels + px[i] + py[i] * STRIDE(sheet);
+
+		// one sheet has one alpha format
+		for (register int row = 0; row < b->clip.h; ++row, s += STRIDE(b), d += STRIDE(sheet))
+			if (premultiplied && !b->premultiplied)
+				premultiplySpan(d, s, b->clip.w);
+			else
+				memcpy(d, s, b->clip.w * sizeof(uint32_t));
+		SDL_ContextAtlasAddRegion(atlas, names ? names[i] : NULL, px[i], py[i], b->clip.w, b->clip.h);
+	}
+
+	xfree(items);
+	xfree(px);
+	xfree(py);
+	return atlas;
+}
+
+SDL_ContextAtlas* SDL_ContextLoadAtlas(const char* const paths[], int count, int width)
+{
+	SDL_ContextBitmap** bitmaps = xcalloc(MAX(count, 1), sizeof(SDL_ContextBitmap*));
+	SDL_ContextAtlas* atlas = NULL;
+	register int i;
+
+	for (i = 0; i < count; ++i)
+		if (!(bitmaps[i] = SDL_ContextLoadBitmap(paths[i])))
+			goto __sdlctx_atlas_cleanup__;
+
+	// regions are named after files
+	atlas = SDL_ContextPackAtlas((const SDL_ContextBitmap* const*)bitmaps, paths, count, width);
+__sdlctx_atlas_cleanup__:
+	for (i = 0; i < count; ++i)
+		SDL_ContextDestroyBitmap(bitmaps[i]);
+	xfree(bitmaps);
+	return atlas;
+}
@@ -0,0 +1,187 @@
+/*
+ * Title: SDL_ContextBatch.c
+ * Autor: @ooichu
+ * Description: Sprite batches, part of SDL_Context library.
+ * Sprite draws are collected with a layer, sorted by layer and source and
+ * drawn together, so one source sheet is used at a time. Draws of one layer
+ * with the same source keep their order whatever their blend modes are,
+ * different sources within a layer are not ordered.
+ */
+
+typedef struct
+{
+	const SDL_ContextBitmap* src;
+	const SDL_ContextSprite* sprite;
+	const void* key; // source pixels, regions of one sheet share it
+	int layer, args[6];
+	float fargs[3];
+	unsigned long seq;
+	uint8_t type, blendMode;
+}
+BatchEntry;
+
+struct SDL_ContextBatch
+{
+	dynarr_t(BatchEntry) list;
+	SDL_ContextBatchStats stats;
+	uint8_t blendMode;
+};
+
+SDL_ContextBatch* SDL_ContextCreateBatch(void)
+{
+	SDL_ContextBatch* batch = xcalloc(1, sizeof(SDL_ContextBatch));
+	dynarr_init(BatchEntry, batch->list);
+	batch->blendMode = SDL_BLENDMODE_BLEND;
+	return batch;
+}
+
+void SDL_ContextDestroyBatch(SDL_ContextBatch* batch)
+{
+	if (!batch) return;
+	dynarr_free(batch->list);
+	xfree(batch);
+}
+
+void SDL_ContextBatchSetBlend(SDL_ContextBatch* batch, uint8_t mode)
+{
+	batch->blendMode = mode;
+}
+
+SDL_ContextBatchStats SDL_ContextBatchGetStats(const SDL_ContextBatch* batch)
+{
+	return batch->stats;
+}
+
+void SDL_ContextBatchClear(SDL_ContextBatch* batch)
+{
+	batch->list.length = 0;
+}
+
+static BatchEntry* pushEntry(SDL_ContextBatch* restrict batch, uint8_t type, int layer, const void* key)
+{
+	if (batch->list.length == batch->list.allocated)
+	{
+		dynarr_resize(batch->list, batch->list.allocated ? batch->list.allocated * 2 : ALLOCATION_STEP);
+		if (!batch->list.pool) PANIC("Cannot allocate memory!");
+	}
+
+	register BatchEntry* restrict e = batch->list.pool + batch->list.length;
+	e->type = type;
+	e->layer = layer;
+	e->key = key;
+	e->blendMode = batch->blendMode;
+	e->seq = batch->list.length++;
+	return e;
+}
+
+void SDL_ContextBatchCopy(SDL_ContextBatch* restrict batch, int layer, const SDL_ContextBitmap* restrict src, int x, int y)
+{
+	register BatchEntry* restrict e = pushEntry(batch, COMMAND_COPY, layer, src->pixels);
+	e->src = src;
+	e->args[0] = x, e->args[1] = y;
+}
+
+void SDL_ContextBatchCopyEx(SDL_ContextBatch* restrict batch, int layer, const SDL_ContextBitmap* restrict src, int x, int y, int sx, int sy, SDL_ContextTransform transform)
+{
+	register BatchEntry* restrict e = pushEntry(batch, COMMAND_COPY_EX, layer, src->pixels);
+	e->src = src;
+	e->args[0] = x, e->args[1] = y, e->args[2] = sx, e->args[3] = sy, e->args[4] = transform;
+}
+
+void SDL_ContextBatchBitmap(SDL_ContextBatch* restrict batch, int layer, const SDL_ContextBitmap* restrict src, int x, int y, float a, int ox, int oy, float sclx, float scly)
+{
+	register BatchEntry* restrict e = pushEntry(batch, COMMAND_BITMAP, layer, src->pixels);
+	e->src = src;
+	e->args[0] = x, e->args[1] = y, e->args[2] = ox, e->args[3] = oy;
+	e->fargs[0] = a, e->fargs[1] = sclx, e->fargs[2] = scly;
+}
+
+void SDL_ContextBatchSprite(SDL_ContextBatch* restrict batch, int layer, const SDL_ContextSprite* restrict spr, int x, int y)
+{
+	register BatchEntry* restrict e = pushEntry(batch, COMMAND_SPRITE, layer, spr->pixels);
+	e->sprite = spr;
+	e->args[0] = x, e->args[1] = y;
+}
+
+// layer, then source, then submission order, blend mode does not reorder
+// draws which may overlap
+static int compareEntries(const void* a, const void* b)
+{
+	register const BatchEntry* const ea = a, *const eb = b;
+	if (ea->layer != eb->layer)
+		return ea->layer < eb->layer ? -1 : 1;
+	if (ea->key != eb->key)
+		return (uintptr_t)ea->key < (uintptr_t)eb->key ? -1 : 1;
+	return ea->seq < eb->seq ? -1 : ea->seq > eb->seq;
+}
+
+// Sort entries and count runs, blend changes are counted as they occur in
+// submission order. Draw is called for every entry in order.
+static void runBatch(SDL_ContextBatch* restrict batch, void (*draw)(void* data, const BatchEntry* e), void* data)
+{
+	register const BatchEntry* e, *prev = NULL;
+	register SDL_ContextBatchStats* const stats = &batch->stats;
+
+	qsort(batch->list.pool, batch->list.length, sizeof(BatchEntry), compareEntries);
+	stats->sprites = batch->list.length;
+	stats->batches = stats->sourceChanges = stats->blendChanges = 0;
+
+	for (e = batch->list.pool; e < batch->list.pool + batch->list.length; prev = e++)
+	{
+		if (!prev || prev->key != e->key || prev->blendMode != e->blendMode)
+			++stats->batches;
+		if (prev && prev->key != e->key)
+			++stats->sourceChanges;
+		if (prev && prev->blendMode != e->blendMode)
+			++stats->blendChanges;
+		draw(data, e);
+	}
+	batch->list.length = 0;
+}
+
+static void drawEntry(void* data, const BatchEntry* e)
+{
+	register SDL_ContextBitmap* const bmp = data;
+	register const int* const a = e->args;
+
+	bmp->blendMode = e->blendMode;
+	switch (e->type)
+	{
+	case COMMAND_COPY: SDL_ContextBitmapCopy(bmp, e->src, a[0], a[1]); break;
+	case COMMAND_COPY_EX: SDL_ContextBitmapCopyEx(bmp, e->src, a[0], a[1], a[2], a[3], (SDL_ContextTransform)a[4]); break;
+	case COMMAND_BITMAP: SDL_ContextBitmapDrawBitmap(bmp, e->src, a[0], a[1], e->fargs[0], a[2], a[3], e->fargs[1], e->fargs[2]); break;
+	case COMMAND_SPRITE: SDL_ContextBitmapCopySprite(bmp, e->sprite, a[0], a[1]); break;
+	default: break;
+	}
+}
+
+static void recordEntry(void* data, const BatchEntry* e)
+{
+	register SDL_Context* const ctx = data;
+	register const int* const a = e->args;
+
+	ctx->bitmap->blendMode = e->blendMode;
+	switch (e->type)
+	{
+	case COMMAND_COPY: SDL_ContextRecordCopy(ctx, e->src, a[0], a[1]); break;
+	case COMMAND_COPY_EX: SDL_ContextRecordCopyEx(ctx, e->src, a[0], a[1], a[2], a[3], (SDL_ContextTransform)a[4]); break;
+	case COMMAND_BITMAP: SDL_ContextRecordBitmap(ctx, e->src, a[0], a[1], e->fargs[0], a[2], a[3], e->fargs[1], e->fargs[2]); break;
+	case COMMAND_SPRITE: SDL_ContextRecordSprite(ctx, e->sprite, a[0], a[1]); break;
+	default: break;
+	}
+}
+
+// Draw and empty the batch, dest blend mode is kept
+void SDL_ContextBitmapDrawBatch(SDL_ContextBitmap* restrict dest, SDL_ContextBatch* restrict batch)
+{
+	const uint8_t mode = dest->blendMode;
+	runBatch(batch, drawEntry, dest);
+	dest->blendMode = mode;
+}
+
+void SDL_ContextRecordBatch(SDL_Context* restrict ctx, SDL_ContextBatch* restrict batch)
+{
+	const uint8_t mode = ctx->bitmap->blendMode;
+	runBatch(batch, recordEntry, ctx);
+	ctx->bitmap->blendMode = mode;
+}
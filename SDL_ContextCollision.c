@@ -0,0 +1,95 @@
+/*
+ * Title: SDL_ContextCollision.c
+ * Autor: @ooichu
+ * Description: Collision masks, part of SDL_Context library.
+ * A mask keeps one bit per pixel, 64 columns in a word. Words of one column
+ * band are stored for all rows in a row, so an overlap test shifts and ANDs
+ * several rows at once after bounding boxes are rejected.
+ */
+
+SDL_ContextCollisionMask* SDL_ContextCreateCollisionMask(const SDL_ContextBitmap* bmp, uint8_t threshold)
+{
+	SDL_ContextCollisionMask* mask = xmalloc(sizeof(SDL_ContextCollisionMask));
+	mask->width = bmp->clip.w;
+	mask->height = bmp->clip.h;
+	mask->words = (mask->width + 63) / 64;
+	mask->bits = xcalloc(MAX(mask->words * mask->height, 1), sizeof(uint64_t));
+	mask->bounds.x1 = mask->width, mask->bounds.y1 = mask->height;
+	mask->bounds.x2 = mask->bounds.y2 = -1;
+
+	register const uint32_t* restrict p;
+	for (register int y = 0; y < mask->height; ++y)
+	{
+		p = bmp->pixels + bmp->clip.x1 + (bmp->clip.y1 + y) * STRIDE(bmp);
+		for (register int x = 0; x < mask->width; ++x)
+			if (SDL_ContextColorA(p[x]) > threshold)
+			{
+				mask->bits[x / 64 * mask->height + y] |= (uint64_t)1 << (x % 64);
+				mask->bounds.x1 = MIN(mask->bounds.x1, x), mask->bounds.x2 = MAX(mask->bounds.x2, x);
+				mask->bounds.y1 = MIN(mask->bounds.y1, y), mask->bounds.y2 = y;
+			}
+	}
+	return mask;
+}
+
+void SDL_ContextDestroyCollisionMask(SDL_ContextCollisionMask* mask)
+{
+	if (!mask) return;
+	xfree(mask->bits);
+	xfree(mask);
+}
+
+bool SDL_ContextCollisionMaskGet(const SDL_ContextCollisionMask* mask, int x, int y)
+{
+	if (x < 0 || y < 0 || x >= mask->width || y >= mask->height)
+		return false;
+	return mask->bits[x / 64 * mask->height + y] >> (x % 64) & 1;
+}
+
+// n rows of word band a against b shifted right by r bits, lo and hi are
+// b bands under a (either may be NULL when out of b)
+static bool overlapBand(const uint64_t* restrict a, const uint64_t* restrict lo, const uint64_t* restrict hi, int r, int n)
+{
+	register int i = 0;
+#ifdef SIMD_PIXELS
+	// SIMD_PIXELS / 2 rows a time
+	const simd_t zero = SIMD_ZERO();
+	register simd_t w;
+	for (; i + SIMD_PIXELS / 2 <= n; i += SIMD_PIXELS / 2)
+	{
+		// shift by 64 clears lanes, so r == 0 needs no care
+		w = SIMD_OR(lo ? SIMD_SRL64(SIMD_LOAD(lo + i), r) : zero, hi ? SIMD_SLL64(SIMD_LOAD(hi + i), 64 - r) : zero);
+		if (!SIMD_TESTZ(SIMD_AND(SIMD_LOAD(a + i), w)))
+			return true;
+	}
+#endif
+	for (; i < n; ++i)
+		if (a[i] & ((lo ? lo[i] >> r : 0) | (hi && r ? hi[i] << (64 - r) : 0)))
+			return true;
+	return false;
+}
+
+bool SDL_ContextCollisionMaskOverlap(const SDL_ContextCollisionMask* a, int ax, int ay, const SDL_ContextCollisionMask* b, int bx, int by)
+{
+	// solid areas in a's space
+	const int x1 = MAX(a->bounds.x1, bx - ax + b->bounds.x1), x2 = MIN(a->bounds.x2, bx - ax + b->bounds.x2);
+	const int y1 = MAX(a->bounds.y1, by - ay + b->bounds.y1), y2 = MIN(a->bounds.y2, by - ay + b->bounds.y2);
+	if (x1 > x2 || y1 > y2)
+		return false;
+
+	// column 64 * k of a is bit r of b word k + q
+	const int d = ax - bx, r = ((d % 64) + 64) % 64, q = (d - r) / 64;
+	const int rb = y1 + ay - by;
+	register int j;
+
+	for (register int k = x1 / 64; k <= x2 / 64; ++k)
+	{
+		j = k + q;
+		if (overlapBand(a->bits + k * a->height + y1,
+			j >= 0 && j < b->words ? b->bits + j * b->height + rb : NULL,
+			j + 1 >= 0 && j + 1 < b->words ? b->bits + (j + 1) * b->height + rb : NULL,
+			r, y2 - y1 + 1))
+			return true;
+	}
+	return false;
+}
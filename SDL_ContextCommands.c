@@ -0,0 +1,576 @@
+/*
+ * Title: SDL_ContextCommands.c
+ * Autor: @ooichu
+ * Description: Recorded draw commands, part of SDL_Context library.
+ * While a context records, SDL_ContextDraw* calls are stored in a per-frame
+ * buffer and executed by SDL_ContextSwapBuffers (or SDL_ContextFlushCommands).
+ * Source bitmaps must stay alive and unchanged until the frame is flushed.
+ * Commands of a frame are kept until the next one starts, for replay.
+ */
+
+// commands looked ahead when searching one with the same state
+#define COMMAND_SORT_WINDOW (32)
+// largest opaque commands remembered while searching overdrawn ones
+#define COMMAND_OCCLUDERS (16)
+// side of square screen tile drawn by one job
+#define COMMAND_TILE (64)
+
+enum
+{
+	COMMAND_NONE,
+	COMMAND_CLEAR,
+	COMMAND_POINT,
+	COMMAND_LINE,
+	COMMAND_RECT,
+	COMMAND_FILL_RECT,
+	COMMAND_CIRCLE,
+	COMMAND_FILL_CIRCLE,
+	COMMAND_TRIANGLE,
+	COMMAND_FILL_TRIANGLE,
+	COMMAND_COPY,
+	COMMAND_COPY_EX,
+	COMMAND_BITMAP,
+	COMMAND_SPRITE
+};
+
+typedef struct
+{
+	int x1, y1, x2, y2;
+}
+CommandClip;
+
+typedef struct SDL_ContextCommand
+{
+	const SDL_ContextBitmap* src; // source bitmap, drawn with srcClip
+	const SDL_ContextSprite* sprite;
+	CommandClip clip, srcClip;    // destination and source clips at record time
+	int x1, y1, x2, y2;           // clipped bounds, nothing outside is touched
+	int args[6];
+	float fargs[3];
+	uint32_t val, mask;
+	uint8_t type, blendMode;
+	bool premultiplied;           // of source at record time
+}
+SDL_ContextCommand;
+
+// Serial of kept command frames, advanced whenever a frame is dropped.
+// Cached text pinned with the current serial is drawn by kept commands.
+static unsigned long commandFrame = 1;
+
+struct SDL_ContextCommandBuffer
+{
+	dynarr_t(SDL_ContextCommand) list;
+	dynarr_t(SDL_ContextSprite*) garbage; // destroyed when frame is dropped
+	unsigned long executed;
+	uint32_t flags;
+	bool frameDone;
+	// tile bins
+	unsigned long* first, *refs;
+	unsigned long allocatedRefs;
+	int tiles;
+};
+
+// Commands of finished frame are dropped with sprites only they still draw
+static void dropFrame(struct SDL_ContextCommandBuffer* restrict buf)
+{
+	buf->list.length = buf->executed = 0;
+	while (buf->garbage.length)
+		SDL_ContextDestroySprite(dynarr_pop(buf->garbage));
+	++commandFrame;
+}
+
+// Sprite which may be drawn by kept commands is destroyed with them
+static void dropSprite(struct SDL_ContextCommandBuffer* restrict buf, SDL_ContextSprite* spr)
+{
+	if (buf->garbage.length == buf->garbage.allocated)
+	{
+		dynarr_resize(buf->garbage, buf->garbage.allocated ? buf->garbage.allocated * 2 : ALLOCATION_STEP);
+		if (!buf->garbage.pool) PANIC("Cannot allocate memory!");
+	}
+	dynarr_push(buf->garbage, spr);
+}
+
+static SDL_ContextCommand* pushCommand(SDL_Context* restrict ctx, uint8_t type, int x1, int y1, int x2, int y2)
+{
+	register struct SDL_ContextCommandBuffer* restrict buf = ctx->commands;
+
+	// first command of a new frame drops the previous one
+	if (buf->frameDone)
+	{
+		dropFrame(buf);
+		buf->frameDone = false;
+	}
+
+	if (buf->list.length == buf->list.allocated)
+	{
+		dynarr_resize(buf->list, buf->list.allocated ? buf->list.allocated * 2 : ALLOCATION_STEP);
+		if (!buf->list.pool) PANIC("Cannot allocate memory!");
+	}
+
+	register const SDL_ContextBitmap* restrict bmp = ctx->bitmap;
+	register SDL_ContextCommand* restrict cmd = buf->list.pool + buf->list.length++;
+	cmd->type = type;
+	cmd->blendMode = bmp->blendMode;
+	cmd->mask = bmp->mask;
+	cmd->clip.x1 = bmp->clip.x1, cmd->clip.y1 = bmp->clip.y1;
+	cmd->clip.x2 = bmp->clip.x2, cmd->clip.y2 = bmp->clip.y2;
+	// pool is reused, sameState compares sources of every command
+	cmd->src = NULL;
+	cmd->sprite = NULL;
+	cmd->x1 = MAX(x1, cmd->clip.x1), cmd->y1 = MAX(y1, cmd->clip.y1);
+	cmd->x2 = MIN(x2, cmd->clip.x2), cmd->y2 = MIN(y2, cmd->clip.y2);
+	return cmd;
+}
+
+// Source of copy commands, recorded clip is kept in the command
+static void setSource(SDL_ContextCommand* restrict cmd, const SDL_ContextBitmap* restrict src)
+{
+	cmd->src = src;
+	cmd->srcClip.x1 = src->clip.x1, cmd->srcClip.y1 = src->clip.y1;
+	cmd->srcClip.x2 = src->clip.x2, cmd->srcClip.y2 = src->clip.y2;
+	cmd->premultiplied = src->premultiplied;
+}
+
+static void setClip(SDL_ContextBitmap* restrict bmp, const CommandClip* restrict clip)
+{
+	bmp->clip.x1 = clip->x1, bmp->clip.y1 = clip->y1;
+	bmp->clip.x2 = clip->x2, bmp->clip.y2 = clip->y2;
+	bmp->clip.w = clip->x2 - clip->x1 + 1, bmp->clip.h = clip->y2 - clip->y1 + 1;
+}
+
+// Draw command with clip already set in bmp
+static void runCommand(SDL_ContextBitmap* restrict bmp, const SDL_ContextCommand* restrict cmd)
+{
+	register const int* const a = cmd->args;
+	SDL_ContextBitmap src;
+
+	bmp->blendMode = cmd->blendMode;
+	bmp->mask = cmd->mask;
+	if (cmd->src)
+	{
+		src = *cmd->src;
+		setClip(&src, &cmd->srcClip);
+		src.premultiplied = cmd->premultiplied;
+	}
+
+	switch (cmd->type)
+	{
+	case COMMAND_CLEAR: SDL_ContextBitmapClear(bmp, cmd->val); break;
+	case COMMAND_POINT: SDL_ContextBitmapDrawPoint(bmp, a[0], a[1], cmd->val); break;
+	case COMMAND_LINE: SDL_ContextBitmapDrawLine(bmp, a[0], a[1], a[2], a[3], cmd->val); break;
+	case COMMAND_RECT: SDL_ContextBitmapDrawRect(bmp, a[0], a[1], a[2], a[3], cmd->val); break;
+	case COMMAND_FILL_RECT: SDL_ContextBitmapFillRect(bmp, a[0], a[1], a[2], a[3], cmd->val); break;
+	case COMMAND_CIRCLE: SDL_ContextBitmapDrawCircle(bmp, a[0], a[1], a[2], cmd->val); break;
+	case COMMAND_FILL_CIRCLE: SDL_ContextBitmapFillCircle(bmp, a[0], a[1], a[2], cmd->val); break;
+	case COMMAND_TRIANGLE: SDL_ContextBitmapDrawTriangle(bmp, a[0], a[1], a[2], a[3], a[4], a[5], cmd->val); break;
+	case COMMAND_FILL_TRIANGLE: SDL_ContextBitmapFillTriangle(bmp, a[0], a[1], a[2], a[3], a[4], a[5], cmd->val); break;
+	case COMMAND_COPY: SDL_ContextBitmapCopy(bmp, &src, a[0], a[1]); break;
+	case COMMAND_COPY_EX: SDL_ContextBitmapCopyEx(bmp, &src, a[0], a[1], a[2], a[3], (SDL_ContextTransform)a[4]); break;
+	case COMMAND_BITMAP: SDL_ContextBitmapDrawBitmap(bmp, &src, a[0], a[1], cmd->fargs[0], a[2], a[3], cmd->fargs[1], cmd->fargs[2]); break;
+	case COMMAND_SPRITE: SDL_ContextBitmapCopySprite(bmp, cmd->sprite, a[0], a[1]); break;
+	default: break;
+	}
+}
+
+// Work shared by tile jobs
+typedef struct
+{
+	const SDL_ContextBitmap* bmp;
+	const SDL_ContextCommand* cmds;
+	const unsigned long* first; // commands of tile i are refs[first[i]..first[i + 1]]
+	const unsigned long* refs;
+	int columns;
+}
+TileWork;
+
+// Every primitive draws exactly the pixels of its unclipped shape which fall
+// inside the clip, so tiles may be drawn independently and in any order.
+static void runTile(void* data, int index)
+{
+	const TileWork* const work = data;
+	SDL_ContextBitmap tile = *work->bmp;
+	tile.dirty.track = false;
+	register const SDL_ContextCommand* restrict cmd;
+
+	const int tx1 = index % work->columns * COMMAND_TILE, ty1 = index / work->columns * COMMAND_TILE;
+	const int tx2 = MIN(tx1 + COMMAND_TILE, tile.width) - 1, ty2 = MIN(ty1 + COMMAND_TILE, tile.height) - 1;
+
+	for (register unsigned long i = work->first[index]; i < work->first[index + 1]; ++i)
+	{
+		cmd = work->cmds + work->refs[i];
+		const CommandClip clip = { MAX(cmd->clip.x1, tx1), MAX(cmd->clip.y1, ty1), MIN(cmd->clip.x2, tx2), MIN(cmd->clip.y2, ty2) };
+		setClip(&tile, &clip);
+		runCommand(&tile, cmd);
+	}
+}
+
+// Bin commands into screen tiles by their bounds and draw tiles on the thread pool,
+// false if it is not worth it
+static bool runTiles(struct SDL_ContextCommandBuffer* restrict buf, SDL_ContextBitmap* restrict bmp,
+	const SDL_ContextCommand* restrict cmds, unsigned long n)
+{
+	const int columns = (bmp->width + COMMAND_TILE - 1) / COMMAND_TILE, rows = (bmp->height + COMMAND_TILE - 1) / COMMAND_TILE;
+	const int tiles = columns * rows;
+	if (!SDL_ContextGetThreadCount() || tiles < 2 || n < 2)
+		return false;
+
+	register const SDL_ContextCommand* restrict c;
+	register unsigned long i, refs = 0;
+	register int x, y;
+
+	// count commands per tile, first[] is turned into offsets afterwards
+	if (buf->tiles < tiles + 1)
+		buf->first = xrealloc(buf->first, (buf->tiles = tiles + 1) * sizeof(unsigned long));
+	memset(buf->first, 0, (tiles + 1) * sizeof(unsigned long));
+	for (i = 0, c = cmds; i < n; ++i, ++c)
+		if (c->x1 <= c->x2 && c->y1 <= c->y2)
+			for (y = c->y1 / COMMAND_TILE; y <= c->y2 / COMMAND_TILE; ++y)
+				for (x = c->x1 / COMMAND_TILE; x <= c->x2 / COMMAND_TILE; ++x)
+					++buf->first[x + y * columns + 1], ++refs;
+
+	if (buf->allocatedRefs < refs)
+		buf->refs = xrealloc(buf->refs, (buf->allocatedRefs = refs) * sizeof(unsigned long));
+	for (x = 0; x < tiles; ++x)
+		buf->first[x + 1] += buf->first[x];
+
+	// fill in order, first[t] walks up to the start of tile t + 1 and is restored below
+	for (i = 0, c = cmds; i < n; ++i, ++c)
+		if (c->x1 <= c->x2 && c->y1 <= c->y2)
+			for (y = c->y1 / COMMAND_TILE; y <= c->y2 / COMMAND_TILE; ++y)
+				for (x = c->x1 / COMMAND_TILE; x <= c->x2 / COMMAND_TILE; ++x)
+					buf->refs[buf->first[x + y * columns]++] = i;
+	for (x = tiles; x > 0; --x)
+		buf->first[x] = buf->first[x - 1];
+	buf->first[0] = 0;
+
+	// tiles don't track written areas, bounds of commands are marked instead
+	for (i = 0, c = cmds; i < n; ++i, ++c)
+		SDL_ContextBitmapMarkDirty(bmp, c->x1, c->y1, c->x2 - c->x1 + 1, c->y2 - c->y1 + 1);
+
+	TileWork work = { bmp, cmds, buf->first, buf->refs, columns };
+	runJobs(runTile, &work, tiles);
+	return true;
+}
+
+static void runCommands(struct SDL_ContextCommandBuffer* restrict buf, SDL_ContextBitmap* restrict bmp,
+	const SDL_ContextCommand* restrict cmds, unsigned long n)
+{
+	const SDL_ContextBitmap saved = *bmp;
+
+	if (!(buf->flags & SDL_COMMANDS_TILED) || !runTiles(buf, bmp, cmds, n))
+		for (register unsigned long i = 0; i < n; ++i)
+		{
+			setClip(bmp, &cmds[i].clip);
+			runCommand(bmp, cmds + i);
+		}
+
+	// drawing state belongs to the user again
+	bmp->clip = saved.clip;
+	bmp->blendMode = saved.blendMode;
+	bmp->mask = saved.mask;
+}
+
+// Command overwrites every pixel of its bounds with values not depending on destination
+static bool isOpaque(const SDL_ContextCommand* cmd)
+{
+	switch (cmd->type)
+	{
+	case COMMAND_CLEAR:
+		return true;
+	case COMMAND_FILL_RECT:
+		switch (cmd->blendMode)
+		{
+		case SDL_BLENDMODE_NONE: return true;
+		case SDL_BLENDMODE_MASK: return cmd->val & 0xFF;
+		case SDL_BLENDMODE_BLEND: return (cmd->val & 0xFF) == 0xFF && (cmd->mask & 0xFF) == 0xFF;
+		default: return false;
+		}
+	case COMMAND_COPY:
+	case COMMAND_COPY_EX:
+		return cmd->blendMode == SDL_BLENDMODE_NONE;
+	default:
+		return false;
+	}
+}
+
+static inline bool sameState(const SDL_ContextCommand* a, const SDL_ContextCommand* b)
+{
+	return a->type == b->type && a->src == b->src && a->sprite == b->sprite && a->blendMode == b->blendMode;
+}
+
+static inline bool overlaps(const SDL_ContextCommand* a, const SDL_ContextCommand* b)
+{
+	return a->x1 <= b->x2 && b->x1 <= a->x2 && a->y1 <= b->y2 && b->y1 <= a->y2;
+}
+
+// Drop commands which are clipped out or fully covered by a later opaque command,
+// returns new number of commands
+static unsigned long cullCommands(SDL_ContextCommand* restrict cmds, unsigned long n)
+{
+	struct { int x1, y1, x2, y2; long long area; } occ[COMMAND_OCCLUDERS];
+	register int count = 0, k, m;
+	register SDL_ContextCommand* restrict c;
+
+	for (register unsigned long i = n; i-- > 0;)
+	{
+		c = cmds + i;
+		if (c->x1 > c->x2 || c->y1 > c->y2)
+		{
+			c->type = COMMAND_NONE;
+			continue;
+		}
+
+		for (k = 0; k < count; ++k)
+			if (c->x1 >= occ[k].x1 && c->x2 <= occ[k].x2 && c->y1 >= occ[k].y1 && c->y2 <= occ[k].y2)
+				break;
+		if (k < count)
+		{
+			c->type = COMMAND_NONE;
+			continue;
+		}
+
+		if (!isOpaque(c))
+			continue;
+
+		// keep the largest occluders
+		const long long area = (long long)(c->x2 - c->x1 + 1) * (c->y2 - c->y1 + 1);
+		if (count < COMMAND_OCCLUDERS)
+			k = count++;
+		else
+		{
+			for (k = 0, m = 1; m < count; ++m)
+				if (occ[m].area < occ[k].area) k = m;
+			if (occ[k].area >= area)
+				continue;
+		}
+		occ[k].x1 = c->x1, occ[k].y1 = c->y1, occ[k].x2 = c->x2, occ[k].y2 = c->y2;
+		occ[k].area = area;
+	}
+
+	// compact
+	register unsigned long j = 0;
+	for (register unsigned long i = 0; i < n; ++i)
+		if (cmds[i].type != COMMAND_NONE)
+		{
+			if (i != j) cmds[j] = cmds[i];
+			++j;
+		}
+	return j;
+}
+
+// Pull commands with the same state as their predecessor forward. A command is
+// moved only over commands it does not overlap, so result of drawing is the same.
+static void sortCommands(SDL_ContextCommand* restrict cmds, unsigned long n)
+{
+	SDL_ContextCommand tmp;
+	register unsigned long i, j, k;
+
+	for (i = 1; i < n; ++i)
+	{
+		if (sameState(cmds + i, cmds + i - 1))
+			continue;
+
+		for (j = i + 1; j < n && j < i + COMMAND_SORT_WINDOW; ++j)
+		{
+			if (!sameState(cmds + j, cmds + i - 1))
+				continue;
+
+			for (k = i; k < j && !overlaps(cmds + k, cmds + j); ++k);
+			if (k == j)
+			{
+				tmp = cmds[j];
+				memmove(cmds + i + 1, cmds + i, (j - i) * sizeof(SDL_ContextCommand));
+				cmds[i] = tmp;
+				break;
+			}
+		}
+	}
+}
+
+// Called once per presented frame, frame without commands replays as empty one
+static void endCommandFrame(SDL_Context* restrict ctx)
+{
+	register struct SDL_ContextCommandBuffer* restrict buf = ctx->commands;
+
+	if (buf->frameDone)
+		dropFrame(buf);
+	else
+		SDL_ContextFlushCommands(ctx);
+	buf->frameDone = true;
+}
+
+static inline void destroyCommands(struct SDL_ContextCommandBuffer* buf)
+{
+	dropFrame(buf);
+	dynarr_free(buf->list);
+	dynarr_free(buf->garbage);
+	xfree(buf->first);
+	xfree(buf->refs);
+	xfree(buf);
+}
+
+//
+// Recording control
+//
+
+void SDL_ContextBeginCommands(SDL_Context* restrict ctx, uint32_t flags)
+{
+	if (ctx->commands)
+	{
+		SDL_ContextFlushCommands(ctx);
+		ctx->commands->flags = flags;
+		return;
+	}
+
+	ctx->commands = xcalloc(1, sizeof(struct SDL_ContextCommandBuffer));
+	dynarr_init(SDL_ContextCommand, ctx->commands->list);
+	dynarr_init(SDL_ContextSprite*, ctx->commands->garbage);
+	ctx->commands->flags = flags;
+}
+
+void SDL_ContextEndCommands(SDL_Context* restrict ctx)
+{
+	if (!ctx->commands) return;
+
+	SDL_ContextFlushCommands(ctx);
+	destroyCommands(ctx->commands);
+	ctx->commands = NULL;
+}
+
+void SDL_ContextFlushCommands(SDL_Context* restrict ctx)
+{
+	register struct SDL_ContextCommandBuffer* restrict buf = ctx->commands;
+	if (!buf || buf->frameDone || buf->executed == buf->list.length) return;
+
+	SDL_ContextCommand* const cmds = buf->list.pool + buf->executed;
+	unsigned long n = buf->list.length - buf->executed;
+
+	if (buf->flags & SDL_COMMANDS_CULL)
+	{
+		n = cullCommands(cmds, n);
+		buf->list.length = buf->executed + n;
+	}
+	if (buf->flags & SDL_COMMANDS_SORT)
+		sortCommands(cmds, n);
+
+	runCommands(buf, ctx->bitmap, cmds, n);
+	buf->executed = buf->list.length;
+}
+
+void SDL_ContextReplayCommands(SDL_Context* restrict ctx)
+{
+	if (ctx->commands)
+		runCommands(ctx->commands, ctx->bitmap, ctx->commands->list.pool, ctx->commands->executed);
+}
+
+//
+// Recording
+//
+
+void SDL_ContextRecordClear(SDL_Context* restrict ctx, uint32_t val)
+{
+	pushCommand(ctx, COMMAND_CLEAR, INT_MIN, INT_MIN, INT_MAX, INT_MAX)->val = val;
+}
+
+void SDL_ContextRecordPoint(SDL_Context* restrict ctx, int x, int y, uint32_t val)
+{
+	register SDL_ContextCommand* restrict cmd = pushCommand(ctx, COMMAND_POINT, x, y, x, y);
+	cmd->args[0] = x, cmd->args[1] = y;
+	cmd->val = val;
+}
+
+void SDL_ContextRecordLine(SDL_Context* restrict ctx, int x1, int y1, int x2, int y2, uint32_t val)
+{
+	register SDL_ContextCommand* restrict cmd = pushCommand(ctx, COMMAND_LINE, MIN(x1, x2), MIN(y1, y2), MAX(x1, x2), MAX(y1, y2));
+	cmd->args[0] = x1, cmd->args[1] = y1, cmd->args[2] = x2, cmd->args[3] = y2;
+	cmd->val = val;
+}
+
+static void recordRect(SDL_Context* restrict ctx, uint8_t type, int x, int y, int w, int h, uint32_t val)
+{
+	// outline of degenerate rect may extend to the left of x or above y
+	register SDL_ContextCommand* restrict cmd = pushCommand(ctx, type, MIN(x, x + w - 1), MIN(y, y + h - 1), MAX(x, x + w - 1), MAX(y, y + h - 1));
+	cmd->args[0] = x, cmd->args[1] = y, cmd->args[2] = w, cmd->args[3] = h;
+	if (type == COMMAND_FILL_RECT && (w <= 0 || h <= 0))
+		cmd->x2 = cmd->x1 - 1;
+	cmd->val = val;
+}
+
+void SDL_ContextRecordRect(SDL_Context* restrict ctx, int x, int y, int w, int h, uint32_t val)
+{
+	recordRect(ctx, COMMAND_RECT, x, y, w, h, val);
+}
+
+void SDL_ContextRecordFillRect(SDL_Context* restrict ctx, int x, int y, int w, int h, uint32_t val)
+{
+	recordRect(ctx, COMMAND_FILL_RECT, x, y, w, h, val);
+}
+
+static void recordCircle(SDL_Context* restrict ctx, uint8_t type, int x, int y, int r, uint32_t val)
+{
+	register SDL_ContextCommand* restrict cmd = pushCommand(ctx, type, x - ABS(r), y - ABS(r), x + ABS(r), y + ABS(r));
+	cmd->args[0] = x, cmd->args[1] = y, cmd->args[2] = r;
+	cmd->val = val;
+}
+
+void SDL_ContextRecordCircle(SDL_Context* restrict ctx, int x, int y, int r, uint32_t val)
+{
+	recordCircle(ctx, COMMAND_CIRCLE, x, y, r, val);
+}
+
+void SDL_ContextRecordFillCircle(SDL_Context* restrict ctx, int x, int y, int r, uint32_t val)
+{
+	recordCircle(ctx, COMMAND_FILL_CIRCLE, x, y, r, val);
+}
+
+static void recordTriangle(SDL_Context* restrict ctx, uint8_t type, int x1, int y1, int x2, int y2, int x3, int y3, uint32_t val)
+{
+	register SDL_ContextCommand* restrict cmd = pushCommand(ctx, type,
+		MIN(x1, MIN(x2, x3)), MIN(y1, MIN(y2, y3)), MAX(x1, MAX(x2, x3)), MAX(y1, MAX(y2, y3)));
+	cmd->args[0] = x1, cmd->args[1] = y1, cmd->args[2] = x2;
+	cmd->args[3] = y2, cmd->args[4] = x3, cmd->args[5] = y3;
+	cmd->val = val;
+}
+
+void SDL_ContextRecordTriangle(SDL_Context* restrict ctx, int x1, int y1, int x2, int y2, int x3, int y3, uint32_t val)
+{
+	recordTriangle(ctx, COMMAND_TRIANGLE, x1, y1, x2, y2, x3, y3, val);
+}
+
+void SDL_ContextRecordFillTriangle(SDL_Context* restrict ctx, int x1, int y1, int x2, int y2, int x3, int y3, uint32_t val)
+{
+	recordTriangle(ctx, COMMAND_FILL_TRIANGLE, x1, y1, x2, y2, x3, y3, val);
+}
+
+void SDL_ContextRecordCopy(SDL_Context* restrict ctx, const SDL_ContextBitmap* restrict src, int x, int y)
+{
+	register SDL_ContextCommand* restrict cmd = pushCommand(ctx, COMMAND_COPY, x, y, x + src->clip.w - 1, y + src->clip.h - 1);
+	setSource(cmd, src);
+	cmd->args[0] = x, cmd->args[1] = y;
+}
+
+void SDL_ContextRecordCopyEx(SDL_Context* restrict ctx, const SDL_ContextBitmap* restrict src, int x, int y, int sx, int sy, SDL_ContextTransform transform)
+{
+	const bool rotate = transform & SDL_ROTATE;
+	const int dw = rotate ? src->clip.h * sy : src->clip.w * sx, dh = rotate ? src->clip.w * sx : src->clip.h * sy;
+
+	register SDL_ContextCommand* restrict cmd = pushCommand(ctx, COMMAND_COPY_EX, x, y, x + dw - 1, y + dh - 1);
+	setSource(cmd, src);
+	cmd->args[0] = x, cmd->args[1] = y, cmd->args[2] = sx, cmd->args[3] = sy, cmd->args[4] = transform;
+}
+
+void SDL_ContextRecordBitmap(SDL_Context* restrict ctx, const SDL_ContextBitmap* restrict src, int x, int y, float a, int ox, int oy, float sclx, float scly)
+{
+	// bounds of rotated bitmap are not worth computing here, whole clip is assumed
+	register SDL_ContextCommand* restrict cmd = pushCommand(ctx, COMMAND_BITMAP, INT_MIN, INT_MIN, INT_MAX, INT_MAX);
+	setSource(cmd, src);
+	cmd->args[0] = x, cmd->args[1] = y, cmd->args[2] = ox, cmd->args[3] = oy;
+	cmd->fargs[0] = a, cmd->fargs[1] = sclx, cmd->fargs[2] = scly;
+}
+
+void SDL_ContextRecordSprite(SDL_Context* restrict ctx, const SDL_ContextSprite* restrict spr, int x, int y)
+{
+	register SDL_ContextCommand* restrict cmd = pushCommand(ctx, COMMAND_SPRITE, x + spr->bounds.x1, y + spr->bounds.y1, x + spr->bounds.x2, y + spr->bounds.y2);
+	cmd->sprite = spr;
+	cmd->args[0] = x, cmd->args[1] = y;
+}
@@ -0,0 +1,226 @@
+/*
+ * Title: SDL_ContextFont.c
+ * Autor: @ooichu
+ * Description: Bitmap fonts, part of SDL_Context library.
+ * Glyphs are cells of a sheet kept in an atlas. Strings are laid out once
+ * into a compiled sprite and cached, so text which does not change between
+ * frames is drawn with a single sprite copy.
+ */
+
+// strings kept laid out per font, least recently drawn one is dropped
+#ifndef SDL_CONTEXT_FONT_CACHE
+#define SDL_CONTEXT_FONT_CACHE (64)
+#endif
+
+typedef struct
+{
+	char* text;
+	uint32_t hash, color;
+	SDL_ContextSprite* sprite;
+	unsigned long used;
+	unsigned long frame; // command frame drawing sprite, pinned while it is kept
+}
+FontCacheEntry;
+
+struct SDL_ContextFont
+{
+	SDL_ContextAtlas* atlas;
+	int glyphs[256]; // atlas handles, -1 for missing
+	int width, height;
+	FontCacheEntry cache[SDL_CONTEXT_FONT_CACHE];
+	int cached;
+	unsigned long clock;
+};
+
+// Cells of sheet are glyphs of codes first, first + 1, ... in reading order
+SDL_ContextFont* SDL_ContextCreateFont(SDL_ContextBitmap* sheet, int width, int height, int first)
+{
+	if (width <= 0 || height <= 0)
+	{
+		fprintf(stdout, "SDL_Context(%s): Glyph size must be positive!\n", __func__);
+		SDL_ContextDestroyBitmap(sheet);
+		return NULL;
+	}
+
+	SDL_ContextFont* font = xcalloc(1, sizeof(SDL_ContextFont));
+	if (!(font->atlas = SDL_ContextCreateAtlas(sheet)))
+	{
+		xfree(font);
+		return NULL;
+	}
+	font->width = width, font->height = height;
+	for (register int i = 0; i < 256; ++i)
+		font->glyphs[i] = -1;
+
+	register int code = MAX(first, 0);
+	for (register int y = 0; y + height <= sheet->height; y += height)
+		for (register int x = 0; x + width <= sheet->width && code < 256; x += width)
+			font->glyphs[code++] = SDL_ContextAtlasAddRegion(font->atlas, NULL, x, y, width, height);
+	return font;
+}
+
+SDL_ContextFont* SDL_ContextLoadFont(const char* path, int width, int height, int first, uint32_t transparent)
+{
+	SDL_ContextBitmap* sheet = SDL_ContextLoadBitmapWithTransparent(path, transparent);
+	return sheet ? SDL_ContextCreateFont(sheet, width, height, first) : NULL;
+}
+
+void SDL_ContextDestroyFont(SDL_ContextFont* font)
+{
+	if (!font) return;
+	for (register int i = 0; i < font->cached; ++i)
+	{
+		xfree(font->cache[i].text);
+		SDL_ContextDestroySprite(font->cache[i].sprite);
+	}
+	SDL_ContextDestroyAtlas(font->atlas);
+	xfree(font);
+}
+
+void SDL_ContextFontMeasure(const SDL_ContextFont* font, const char* text, int* w, int* h)
+{
+	register int columns = 0, widest = 0, lines = *text ? 1 : 0;
+	for (; *text; ++text)
+		if (*text == '\n')
+			columns = 0, ++lines;
+		else if (++columns > widest)
+			widest = columns;
+	*w = widest * font->width;
+	*h = lines * font->height;
+}
+
+//
+// String cache
+//
+
+// FNV-1a
+static inline uint32_t hashText(const char* text)
+{
+	register uint32_t hash = 2166136261u;
+	for (; *text; ++text)
+		hash = (hash ^ (uint8_t)*text) * 16777619u;
+	return hash;
+}
+
+// channels multiplied by color, tint of premultiplied pixels has to be
+// premultiplied as well
+static inline uint32_t tintPixel(uint32_t p, uint32_t color)
+{
+	return SDL_ContextColor(
+		div255(SDL_ContextColorR(p) * SDL_ContextColorR(color)),
+		div255(SDL_ContextColorG(p) * SDL_ContextColorG(color)),
+		div255(SDL_ContextColorB(p) * SDL_ContextColorB(color)),
+		div255(SDL_ContextColorA(p) * SDL_ContextColorA(color)));
+}
+
+static SDL_ContextSprite* layoutText(const SDL_ContextFont* font, const char* text, uint32_t color)
+{
+	int w, h;
+	SDL_ContextFontMeasure(font, text, &w, &h);
+	SDL_ContextBitmap* bmp = SDL_ContextCreateBitmap(MAX(w, 1), MAX(h, 1));
+	bmp->premultiplied = SDL_ContextAtlasGetSheet(font->atlas)->premultiplied;
+	const uint32_t tint = bmp->premultiplied ? premultiplyPixel(color) : color;
+
+	register const SDL_ContextBitmap* glyph;
+	register const uint32_t* restrict s;
+	register uint32_t* restrict d;
+	for (register int x = 0, y = 0; *text; ++text)
+	{
+		if (*text == '\n')
+		{
+			x = 0, y += font->height;
+			continue;
+		}
+		if (font->glyphs[(uint8_t)*text] >= 0)
+		{
+			glyph = SDL_ContextAtlasGet(font->atlas, font->glyphs[(uint8_t)*text]);
+			s = glyph->pixels + glyph->clip.x1 + glyph->clip.y1 * STRIDE(glyph);
+			d = bmp->pixels + x + y * STRIDE(bmp);
+			for (register int row = 0; row < font->height; ++row, s += STRIDE(glyph), d += STRIDE(bmp))
+				if (color == 0xFFFFFFFF)
+					memcpy(d, s, font->width * sizeof(uint32_t));
+				else
+					for (register int i = 0; i < font->width; ++i)
+						d[i] = tintPixel(s[i], tint);
+		}
+		x += font->width;
+	}
+
+	SDL_ContextSprite* spr = SDL_ContextCompileSprite(bmp);
+	SDL_ContextDestroyBitmap(bmp);
+	return spr;
+}
+
+static FontCacheEntry* findText(SDL_ContextFont* font, const char* text, uint32_t hash, uint32_t color)
+{
+	for (register FontCacheEntry* e = font->cache; e < font->cache + font->cached; ++e)
+		if (e->hash == hash && e->color == color && !strcmp(e->text, text))
+			return e;
+	return NULL;
+}
+
+// least recently drawn entry, pinned ones only if allowed, NULL if none
+static FontCacheEntry* oldestText(SDL_ContextFont* font, bool pinned)
+{
+	register FontCacheEntry* e = NULL;
+	for (register FontCacheEntry* i = font->cache; i < font->cache + font->cached; ++i)
+		if ((pinned || i->frame != commandFrame) && (!e || i->used < e->used)) e = i;
+	return e;
+}
+
+// Cache entry of text, laid out if it is new. Sprite of entry pinned by kept
+// commands of ctx is destroyed with them, without ctx such entries are not
+// evicted and NULL is returned when all are pinned.
+static FontCacheEntry* cacheText(SDL_ContextFont* font, SDL_Context* ctx, const char* text, uint32_t hash, uint32_t color)
+{
+	register FontCacheEntry* e = findText(font, text, hash, color);
+	if (!e)
+	{
+		if (font->cached < SDL_CONTEXT_FONT_CACHE)
+			e = font->cache + font->cached++;
+		else
+		{
+			if (!(e = oldestText(font, ctx && ctx->commands)))
+				return NULL;
+			xfree(e->text);
+			if (e->frame == commandFrame)
+				dropSprite(ctx->commands, e->sprite);
+			else
+				SDL_ContextDestroySprite(e->sprite);
+		}
+		e->text = xmalloc(strlen(text) + 1);
+		strcpy(e->text, text);
+		e->hash = hash, e->color = color;
+		e->sprite = layoutText(font, text, color);
+		e->frame = 0;
+	}
+	e->used = ++font->clock;
+	return e;
+}
+
+//
+// Drawing
+//
+
+void SDL_ContextBitmapDrawText(SDL_ContextBitmap* restrict dest, SDL_ContextFont* restrict font, const char* text, int x, int y, uint32_t color)
+{
+	const FontCacheEntry* const e = cacheText(font, NULL, text, hashText(text), color);
+	if (e)
+	{
+		SDL_ContextBitmapCopySprite(dest, e->sprite, x, y);
+		return;
+	}
+
+	// every cached sprite may still be drawn by recorded commands
+	SDL_ContextSprite* const spr = layoutText(font, text, color);
+	SDL_ContextBitmapCopySprite(dest, spr, x, y);
+	SDL_ContextDestroySprite(spr);
+}
+
+void SDL_ContextRecordText(SDL_Context* restrict ctx, SDL_ContextFont* restrict font, const char* text, int x, int y, uint32_t color)
+{
+	register FontCacheEntry* const e = cacheText(font, ctx, text, hashText(text), color);
+	// recording may start a new frame, pin is taken afterwards
+	SDL_ContextRecordSprite(ctx, e->sprite, x, y);
+	e->frame = commandFrame;
+}
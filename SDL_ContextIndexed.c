@@ -0,0 +1,320 @@
+/*
+ * Title: SDL_ContextIndexed.c
+ * Autor: @ooichu
+ * Description: 8-bit indexed bitmaps, part of SDL_Context library.
+ * Pixels are indices into a 256-entry palette of SDL_CONTEXT_PIXELFORMAT
+ * colors, they are converted only when copied into a bitmap or presented,
+ * so changing the palette recolors everything drawn with it.
+ */
+
+SDL_ContextIndexedBitmap* SDL_ContextCreateIndexed(int width, int height)
+{
+	SDL_ContextIndexedBitmap* bmp = xmalloc(sizeof(SDL_ContextIndexedBitmap));
+	bmp->width = width;
+	bmp->height = height;
+	bmp->clip.x1 = bmp->clip.y1 = 0;
+	bmp->clip.x2 = width - 1, bmp->clip.y2 = height - 1;
+	bmp->clip.w = width, bmp->clip.h = height;
+	bmp->pitch = width;
+	bmp->pixels = xcalloc(1, bmp->pitch * height);
+	memset(bmp->palette, 0, sizeof(bmp->palette));
+	bmp->key = -1;
+	return bmp;
+}
+
+// only 8-bit BMP files are accepted, their palette is taken as it is
+SDL_ContextIndexedBitmap* SDL_ContextLoadIndexed(const char* path)
+{
+	SDL_Surface* restrict tmp = SDL_LoadBMP(path);
+	if (!tmp)
+	{
+		fprintf(stdout, "SDL_Context(%s): Load image failed! File: %s\n", __func__, path);
+		return NULL;
+	}
+	if (tmp->format->BitsPerPixel != 8 || !tmp->format->palette)
+	{
+		fprintf(stdout, "SDL_Context(%s): Image is not 8-bit indexed! File: %s\n", __func__, path);
+		SDL_FreeSurface(tmp);
+		return NULL;
+	}
+
+	SDL_ContextIndexedBitmap* bmp = SDL_ContextCreateIndexed(tmp->w, tmp->h);
+	for (register int y = 0; y < bmp->height; ++y)
+		memcpy(bmp->pixels + y * bmp->pitch, (const uint8_t*)tmp->pixels + y * tmp->pitch, bmp->width);
+	for (register int i = 0; i < MIN(tmp->format->palette->ncolors, 256); ++i)
+	{
+		const SDL_Color c = tmp->format->palette->colors[i];
+		bmp->palette[i] = SDL_ContextColor((uint32_t)c.r, c.g, c.b, c.a);
+	}
+	SDL_FreeSurface(tmp);
+	return bmp;
+}
+
+void SDL_ContextDestroyIndexed(SDL_ContextIndexedBitmap* bmp)
+{
+	if (!bmp) return;
+	xfree(bmp->pixels);
+	xfree(bmp);
+}
+
+void SDL_ContextIndexedSetPalette(SDL_ContextIndexedBitmap* bmp, const uint32_t colors[], int first, int count)
+{
+	if (first < 0 || count <= 0 || first >= 256)
+		return;
+	memcpy(bmp->palette + first, colors, MIN(count, 256 - first) * sizeof(uint32_t));
+}
+
+// rotate entries first..first+count-1 by shift places
+void SDL_ContextIndexedCyclePalette(SDL_ContextIndexedBitmap* bmp, int first, int count, int shift)
+{
+	uint32_t tmp[256];
+	if (first < 0 || count <= 1 || first + count > 256 || !(shift %= count))
+		return;
+	if (shift < 0)
+		shift += count;
+	memcpy(tmp, bmp->palette + first, count * sizeof(uint32_t));
+	for (register int i = 0; i < count; ++i)
+		bmp->palette[first + (i + shift) % count] = tmp[i];
+}
+
+//
+// Palette expansion
+//
+
+// Convert n indices to colors. AVX2 gathers eight colors at once, SSE2 has
+// no gather: sixteen indices are loaded at once and four looked up colors
+// are stored as one vector.
+static void expandSpan(uint32_t* restrict dest, const uint8_t* restrict src, int n, const uint32_t* restrict palette)
+{
+#if defined(SIMD_PIXELS) && defined(__AVX2__)
+	for (; n >= 8; n -= 8, src += 8, dest += 8)
+		_mm256_storeu_si256((__m256i*)dest, _mm256_i32gather_epi32((const int*)palette, _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)src)), 4));
+#elif defined(SIMD_PIXELS)
+	register simd_t v;
+	register uint32_t i;
+#define EXPAND_QUARTER(k) \
+	i = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(v, 4 * (k))); \
+	SIMD_STORE(dest + 4 * (k), _mm_set_epi32((int)palette[i >> 24], (int)palette[i >> 16 & 0xFF], (int)palette[i >> 8 & 0xFF], (int)palette[i & 0xFF]))
+	for (; n >= 16; n -= 16, src += 16, dest += 16)
+	{
+		v = SIMD_LOAD(src);
+		EXPAND_QUARTER(0);
+		EXPAND_QUARTER(1);
+		EXPAND_QUARTER(2);
+		EXPAND_QUARTER(3);
+	}
+#undef EXPAND_QUARTER
+#endif // SIMD_PIXELS
+	for (; n >= 4; n -= 4, src += 4, dest += 4)
+	{
+		dest[0] = palette[src[0]];
+		dest[1] = palette[src[1]];
+		dest[2] = palette[src[2]];
+		dest[3] = palette[src[3]];
+	}
+	for (; n > 0; --n)
+		*dest++ = palette[*src++];
+}
+
+typedef struct
+{
+	const SDL_ContextIndexedBitmap* src;
+	uint8_t* pixels;
+	int pitch;
+}
+ExpandRows;
+
+static void expandRows(void* data, int y1, int y2)
+{
+	const ExpandRows* const job = data;
+	for (; y1 < y2; ++y1)
+		expandSpan((uint32_t*)(job->pixels + y1 * job->pitch), job->src->pixels + y1 * job->src->pitch, job->src->width, job->src->palette);
+}
+
+void SDL_ContextIndexedExpand(const SDL_ContextIndexedBitmap* bmp, uint32_t pixels[], int pitch)
+{
+	ExpandRows job = { bmp, (uint8_t*)pixels, pitch };
+	SDL_ContextParallelRows(0, bmp->height, bmp->width, expandRows, &job);
+}
+
+void SDL_ContextSetIndexedFramebuffer(SDL_Context* ctx, SDL_ContextIndexedBitmap* bmp)
+{
+	if (bmp && (bmp->width != ctx->bitmap->width || bmp->height != ctx->bitmap->height))
+	{
+		fprintf(stdout, "SDL_Context(%s): Indexed frame buffer size differs from frame buffer!\n", __func__);
+		return;
+	}
+
+	// switching back presents the whole frame buffer again
+	if (ctx->indexed && !bmp)
+		markDirty(ctx->bitmap, 0, 0, ctx->bitmap->width - 1, ctx->bitmap->height - 1);
+	ctx->indexed = bmp;
+}
+
+// Copy visible part of src into a bitmap through the palette, blended with
+// dest->blendMode. Runs between key pixels are expanded into a small buffer.
+void SDL_ContextBitmapCopyIndexed(SDL_ContextBitmap* restrict dest, const SDL_ContextIndexedBitmap* restrict src, int x, int y)
+{
+	const int x1 = MAX(x, dest->clip.x1), y1 = MAX(y, dest->clip.y1);
+	const int x2 = MIN(x + src->clip.w, dest->clip.x2 + 1), y2 = MIN(y + src->clip.h, dest->clip.y2 + 1);
+	if (x1 >= x2 || y1 >= y2)
+		return;
+
+	markDirty(dest, x1, y1, x2 - 1, y2 - 1);
+	uint32_t buf[256];
+	register const uint8_t* restrict s = src->pixels + (x1 - x + src->clip.x1) + (y1 - y + src->clip.y1) * src->pitch;
+	register uint32_t* restrict d = dest->pixels + x1 + y1 * STRIDE(dest);
+	register int i, j, n;
+
+#define COPY_INDEXED(mode) \
+	for (register int row = y1; row < y2; ++row, s += src->pitch, d += STRIDE(dest)) \
+		for (i = 0; i < x2 - x1; i = j) \
+		{ \
+			if (s[i] == src->key) \
+			{ \
+				j = i + 1; \
+				continue; \
+			} \
+			for (j = i + 1, n = MIN(x2 - x1, i + 256); j < n && s[j] != src->key; ++j); \
+			expandSpan(buf, s + i, j - i, src->palette); \
+			copySpan##mode(d + i, buf, j - i, dest->mask); \
+		}
+	BLEND_DISPATCH(dest->blendMode, COPY_INDEXED);
+#undef COPY_INDEXED
+}
+
+//
+// Drawing indices
+//
+
+void SDL_ContextIndexedClip(SDL_ContextIndexedBitmap* bmp, int x, int y, int w, int h)
+{
+	bmp->clip.x1 = CLAMP(x, 0, bmp->width - 1);
+	bmp->clip.y1 = CLAMP(y, 0, bmp->height - 1);
+	bmp->clip.x2 = CLAMP(x + w, 0, bmp->width - 1);
+	bmp->clip.y2 = CLAMP(y + h, 0, bmp->height - 1);
+	bmp->clip.w = bmp->clip.x2 - bmp->clip.x1 + 1;
+	bmp->clip.h = bmp->clip.y2 - bmp->clip.y1 + 1;
+}
+
+uint8_t SDL_ContextIndexedGetPixel(const SDL_ContextIndexedBitmap* bmp, int x, int y)
+{
+	return (x < bmp->clip.x1 || y < bmp->clip.y1 || x > bmp->clip.x2 || y > bmp->clip.y2) ? 0 : bmp->pixels[x + y * bmp->pitch];
+}
+
+void SDL_ContextIndexedClear(SDL_ContextIndexedBitmap* bmp, uint8_t index)
+{
+	if (bmp->clip.w == bmp->pitch)
+	{
+		memset(bmp->pixels + bmp->clip.y1 * bmp->pitch, index, bmp->pitch * bmp->clip.h);
+		return;
+	}
+
+	for (register int y = bmp->clip.y1; y <= bmp->clip.y2; ++y)
+		memset(bmp->pixels + bmp->clip.x1 + y * bmp->pitch, index, bmp->clip.w);
+}
+
+void SDL_ContextIndexedDrawPoint(SDL_ContextIndexedBitmap* bmp, int x, int y, uint8_t index)
+{
+	if (x < bmp->clip.x1 || y < bmp->clip.y1 || x > bmp->clip.x2 || y > bmp->clip.y2)
+		return;
+
+	bmp->pixels[x + y * bmp->pitch] = index;
+}
+
+// same pixels as SDL_ContextBitmapDrawLine
+void SDL_ContextIndexedDrawLine(SDL_ContextIndexedBitmap* bmp, int x1, int y1, int x2, int y2, uint8_t index)
+{
+	if (y1 == y2)
+	{
+		if (x1 > x2) SWAP(x1, x2);
+		SDL_ContextIndexedFillRect(bmp, x1, y1, x2 - x1 + 1, 1, index);
+		return;
+	}
+	if (x1 == x2)
+	{
+		if (y1 > y2) SWAP(y1, y2);
+		SDL_ContextIndexedFillRect(bmp, x1, y1, 1, y2 - y1 + 1, index);
+		return;
+	}
+
+	LineSteps s;
+	if (!clipSegment(bmp->clip.x1, bmp->clip.y1, bmp->clip.x2, bmp->clip.y2, bmp->pitch, x1, y1, x2, y2, 0, &s))
+		return;
+	register uint8_t* restrict p = bmp->pixels + s.offset;
+	STEP_SEGMENT(s, p, *p = index);
+}
+
+void SDL_ContextIndexedFillRect(SDL_ContextIndexedBitmap* bmp, int x, int y, int w, int h, uint8_t index)
+{
+	const int x1 = MAX(x, bmp->clip.x1), y1 = MAX(y, bmp->clip.y1);
+	const int x2 = MIN(x + w, bmp->clip.x2 + 1), y2 = MIN(y + h, bmp->clip.y2 + 1);
+	if (x1 >= x2 || y1 >= y2)
+		return;
+
+	for (register uint8_t* restrict p = bmp->pixels + x1 + y1 * bmp->pitch, *const end = p + (y2 - y1) * bmp->pitch; p < end; p += bmp->pitch)
+		memset(p, index, x2 - x1);
+}
+
+void SDL_ContextIndexedDrawRect(SDL_ContextIndexedBitmap* bmp, int x, int y, int w, int h, uint8_t index)
+{
+	--w; --h;
+	SDL_ContextIndexedFillRect(bmp, x + 1, y, w, 1, index);
+	SDL_ContextIndexedFillRect(bmp, x, y + h, w, 1, index);
+	SDL_ContextIndexedFillRect(bmp, x, y, 1, h, index);
+	SDL_ContextIndexedFillRect(bmp, x + w, y + 1, 1, h, index);
+}
+
+// same shape as SDL_ContextBitmapFillCircle
+void SDL_ContextIndexedFillCircle(SDL_ContextIndexedBitmap* bmp, int xm, int ym, int r, uint8_t index)
+{
+	if (r < 0 || xm + r < bmp->clip.x1 || xm - r > bmp->clip.x2 || ym + r < bmp->clip.y1 || ym - r > bmp->clip.y2)
+		return;
+
+	const int y1 = MAX(ym - r, bmp->clip.y1), y2 = MIN(ym + r, bmp->clip.y2), rr = r * r;
+	register int w = 0, dy, xa, xb;
+	for (register int y = y1; y <= y2; ++y)
+	{
+		dy = y - ym;
+		while ((w + 1) * (w + 1) + dy * dy <= rr) ++w;
+		while (w * w + dy * dy > rr) --w;
+		xa = MAX(xm - w, bmp->clip.x1), xb = MIN(xm + w, bmp->clip.x2);
+		if (xa <= xb) memset(bmp->pixels + xa + y * bmp->pitch, index, xb - xa + 1);
+	}
+}
+
+// Copy visible part of src, indices equal to src->key are skipped
+void SDL_ContextIndexedCopy(SDL_ContextIndexedBitmap* restrict dest, const SDL_ContextIndexedBitmap* restrict src, int x, int y)
+{
+	const int x1 = MAX(x, dest->clip.x1), y1 = MAX(y, dest->clip.y1);
+	const int x2 = MIN(x + src->clip.w, dest->clip.x2 + 1), y2 = MIN(y + src->clip.h, dest->clip.y2 + 1);
+	if (x1 >= x2 || y1 >= y2)
+		return;
+
+	register const uint8_t* restrict s = src->pixels + (x1 - x + src->clip.x1) + (y1 - y + src->clip.y1) * src->pitch;
+	register uint8_t* restrict d = dest->pixels + x1 + y1 * dest->pitch;
+	register int n;
+
+	if (src->key < 0)
+	{
+		for (register int row = y1; row < y2; ++row, s += src->pitch, d += dest->pitch)
+			memcpy(d, s, x2 - x1);
+		return;
+	}
+
+	for (register int row = y1; row < y2; ++row, s += src->pitch, d += dest->pitch)
+	{
+		n = 0;
+#ifdef SIMD_PIXELS
+		const simd_t k = SIMD_SET8(src->key);
+		for (simd_t m, v; n + SIMD_PIXELS * 4 <= x2 - x1; n += SIMD_PIXELS * 4)
+		{
+			v = SIMD_LOAD(s + n);
+			m = SIMD_CMPEQ8(v, k);
+			SIMD_STORE(d + n, SIMD_OR(SIMD_AND(m, SIMD_LOAD(d + n)), SIMD_ANDNOT(m, v)));
+		}
+#endif // SIMD_PIXELS
+		for (; n < x2 - x1; ++n)
+			if (s[n] != src->key) d[n] = s[n];
+	}
+}
@@ -17,7 +17,10 @@ static inline SDL_Context* getContext(lua_State* L)
 	lua_getglobal(L, "sdlctx");
 	lua_pushlstring(L, "ctx", 3);
 	lua_gettable(L, -2);
-	return (SDL_Context*)lua_touserdata(L, -1);
+	SDL_Context* const ctx = (SDL_Context*)lua_touserdata(L, -1);
+	// leave stack as it was, drawing macros may evaluate ctx more than once
+	lua_pop(L, 2);
+	return ctx;
 }
 
 static inline bool getQuitFlag(lua_State* L)
@@ -180,6 +183,82 @@ static inline int l_filltriangle(lua_State* L)
 	return 0;
 }
 
+//
+// Batched primitives, tables are flat: {x1, y1, x2, y2, ...}, {x, y, w, h, ...} or {x, y, r, ...}
+//
+
+enum { BATCH_POINTS, BATCH_LINES, BATCH_RECTS, BATCH_FILL_RECTS, BATCH_CIRCLES, BATCH_FILL_CIRCLES };
+
+static inline int* toInts(lua_State* L, int idx, int stride, int* count)
+{
+	const int n = lua_rawlen(L, idx) / stride * stride;
+	int* const values = lua_newuserdata(L, sizeof(int) * (n ? n : 1));
+	for (int i = 0; i < n; ++i)
+	{
+		lua_rawgeti(L, idx, i + 1);
+		values[i] = lua_tonumber(L, -1);
+		lua_pop(L, 1);
+	}
+	*count = n / stride;
+	return values;
+}
+
+// points, rects and circles are structs of ints, laid out like the flat table
+static int drawBatch(lua_State* L, const char* func, int type)
+{
+	static const int strides[] = { 2, 2, 4, 4, 3, 3 };
+	if (!lua_istable(L, 1))
+	{
+		fprintf(stdout, "SDL_Context(%s): Syntax error!\n", func);
+		return 0;
+	}
+
+	const uint32_t color = lua_gettop(L) >= 2 ? lua_tointeger(L, 2) : 0x000000FF;
+	int count;
+	const int* const values = toInts(L, 1, strides[type], &count);
+	SDL_Context* const ctx = getContext(L);
+	switch (type)
+	{
+		case BATCH_POINTS: SDL_ContextDrawPoints(ctx, (const SDL_Point*)values, count, color); break;
+		case BATCH_LINES: SDL_ContextDrawLines(ctx, (const SDL_Point*)values, count, color); break;
+		case BATCH_RECTS: SDL_ContextDrawRects(ctx, (const SDL_Rect*)values, count, color); break;
+		case BATCH_FILL_RECTS: SDL_ContextFillRects(ctx, (const SDL_Rect*)values, count, color); break;
+		case BATCH_CIRCLES: SDL_ContextDrawCircles(ctx, (const SDL_ContextCircle*)values, count, color); break;
+		case BATCH_FILL_CIRCLES: SDL_ContextFillCircles(ctx, (const SDL_ContextCircle*)values, count, color); break;
+	}
+	return 0;
+}
+
+static inline int l_drawpoints(lua_State* L)
+{
+	return drawBatch(L, __func__, BATCH_POINTS);
+}
+
+static inline int l_drawlines(lua_State* L)
+{
+	return drawBatch(L, __func__, BATCH_LINES);
+}
+
+static inline int l_drawrects(lua_State* L)
+{
+	return drawBatch(L, __func__, BATCH_RECTS);
+}
+
+static inline int l_fillrects(lua_State* L)
+{
+	return drawBatch(L, __func__, BATCH_FILL_RECTS);
+}
+
+static inline int l_drawcircles(lua_State* L)
+{
+	return drawBatch(L, __func__, BATCH_CIRCLES);
+}
+
+static inline int l_fillcircles(lua_State* L)
+{
+	return drawBatch(L, __func__, BATCH_FILL_CIRCLES);
+}
+
 static inline int luaopen_gfx(lua_State* L)
 {
 	static const luaL_Reg lib[] = {
@@ -195,6 +274,12 @@ static inline int luaopen_gfx(lua_State* L)
 		{"fillcircle", l_fillcircle},
 		{"drawtriangle", l_drawtriangle},
 		{"filltriangle", l_filltriangle},
+		{"drawpoints", l_drawpoints},
+		{"drawlines", l_drawlines},
+		{"drawrects", l_drawrects},
+		{"fillrects", l_fillrects},
+		{"drawcircles", l_drawcircles},
+		{"fillcircles", l_fillcircles},
 //		{"drawbitmap", l_drawbitmap},
 		{NULL, NULL}
 	};
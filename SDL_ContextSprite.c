@@ -0,0 +1,116 @@
+/*
+ * Title: SDL_ContextSprite.c
+ * Autor: @ooichu
+ * Description: Compiled sprites, part of SDL_Context library.
+ * A bitmap is compiled once into per-row runs of non-transparent pixels.
+ * Opaque runs are copied as they are, translucent runs are blended and
+ * transparent pixels are never visited.
+ */
+
+enum
+{
+	SPRITE_TRANSPARENT,
+	SPRITE_TRANSLUCENT,
+	SPRITE_OPAQUE
+};
+
+// runs break where this changes
+static inline int alphaClass(uint32_t p)
+{
+	return !SDL_ContextColorA(p) ? SPRITE_TRANSPARENT : SDL_ContextColorA(p) == 0xFF ? SPRITE_OPAQUE : SPRITE_TRANSLUCENT;
+}
+
+SDL_ContextSprite* SDL_ContextCompileSprite(const SDL_ContextBitmap* bmp)
+{
+	SDL_ContextSprite* spr = xmalloc(sizeof(SDL_ContextSprite));
+	register const uint32_t* restrict p;
+	register int x, n, c, runs = 0, pixels = 0;
+
+	spr->width = bmp->clip.w;
+	spr->height = bmp->clip.h;
+	spr->premultiplied = bmp->premultiplied;
+	spr->bounds.x1 = spr->width, spr->bounds.y1 = spr->height;
+	spr->bounds.x2 = spr->bounds.y2 = -1;
+
+	// count runs and pixels first
+	for (register int y = 0; y < spr->height; ++y)
+	{
+		p = bmp->pixels + bmp->clip.x1 + (bmp->clip.y1 + y) * STRIDE(bmp);
+		for (x = 0; x < spr->width; x += n)
+		{
+			c = alphaClass(p[x]);
+			for (n = 1; x + n < spr->width && alphaClass(p[x + n]) == c; ++n);
+			if (c == SPRITE_TRANSPARENT)
+				continue;
+			++runs, pixels += n;
+			spr->bounds.x1 = MIN(spr->bounds.x1, x), spr->bounds.x2 = MAX(spr->bounds.x2, x + n - 1);
+			spr->bounds.y1 = MIN(spr->bounds.y1, y), spr->bounds.y2 = y;
+		}
+	}
+
+	spr->rows = xmalloc((spr->height + 1) * sizeof(int));
+	spr->runs = xmalloc(MAX(runs, 1) * sizeof(SDL_ContextSpriteRun));
+	spr->pixels = xmalloc(MAX(pixels, 1) * sizeof(uint32_t));
+
+	runs = pixels = 0;
+	for (register int y = 0; y < spr->height; ++y)
+	{
+		spr->rows[y] = runs;
+		p = bmp->pixels + bmp->clip.x1 + (bmp->clip.y1 + y) * STRIDE(bmp);
+		for (x = 0; x < spr->width; x += n)
+		{
+			c = alphaClass(p[x]);
+			for (n = 1; x + n < spr->width && alphaClass(p[x + n]) == c; ++n);
+			if (c == SPRITE_TRANSPARENT)
+				continue;
+			spr->runs[runs].x = x, spr->runs[runs].n = n;
+			spr->runs[runs].offset = pixels;
+			spr->runs[runs].blend = c == SPRITE_TRANSLUCENT;
+			memcpy(spr->pixels + pixels, p + x, n * sizeof(uint32_t));
+			++runs, pixels += n;
+		}
+	}
+	spr->rows[spr->height] = runs;
+	return spr;
+}
+
+void SDL_ContextDestroySprite(SDL_ContextSprite* spr)
+{
+	if (!spr) return;
+	xfree(spr->rows);
+	xfree(spr->runs);
+	xfree(spr->pixels);
+	xfree(spr);
+}
+
+// Same result as SDL_ContextBitmapCopy of the compiled bitmap, except that
+// transparent pixels leave dest untouched in every blend mode.
+void SDL_ContextBitmapCopySprite(SDL_ContextBitmap* restrict dest, const SDL_ContextSprite* restrict spr, int x, int y)
+{
+	const int x1 = MAX(x + spr->bounds.x1, dest->clip.x1), y1 = MAX(y + spr->bounds.y1, dest->clip.y1);
+	const int x2 = MIN(x + spr->bounds.x2, dest->clip.x2), y2 = MIN(y + spr->bounds.y2, dest->clip.y2);
+	if (x1 > x2 || y1 > y2)
+		return;
+
+	markDirty(dest, x1, y1, x2, y2);
+	// opaque pixels are unchanged by blending unless mask alters them
+	const bool copy = dest->blendMode == SDL_BLENDMODE_NONE || dest->mask == 0xFFFFFFFF;
+	register uint32_t* restrict d = dest->pixels + y1 * STRIDE(dest);
+	register const SDL_ContextSpriteRun* r, *end;
+	register int a, b;
+
+#define COPY_SPRITE(mode) \
+	for (register int row = y1; row <= y2; ++row, d += STRIDE(dest)) \
+		for (r = spr->runs + spr->rows[row - y], end = spr->runs + spr->rows[row - y + 1]; r < end && x + r->x <= x2; ++r) \
+		{ \
+			a = MAX(x + r->x, x1), b = MIN(x + r->x + r->n - 1, x2); \
+			if (a > b) \
+				continue; \
+			if (!r->blend && copy) \
+				memcpy(d + a, spr->pixels + r->offset + (a - x - r->x), (b - a + 1) * sizeof(uint32_t)); \
+			else \
+				copySpan##mode(d + a, spr->pixels + r->offset + (a - x - r->x), b - a + 1, dest->mask); \
+		}
+	COPY_DISPATCH(dest, spr, COPY_SPRITE);
+#undef COPY_SPRITE
+}
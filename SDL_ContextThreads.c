@@ -0,0 +1,184 @@
+/*
+ * Title: SDL_ContextThreads.c
+ * Autor: @ooichu
+ * Description: Worker thread pool, part of SDL_Context library.
+ * Jobs are indices 0..count-1 taken by workers and the calling thread,
+ * caller returns when all of them are done. Jobs started from a job or
+ * while another thread uses the pool run on the current thread.
+ */
+
+static struct
+{
+	SDL_Thread** threads;
+	int count;
+	SDL_mutex* lock;
+	SDL_cond* wake, *done;
+	void (*job)(void* data, int index);
+	void* data;
+	int jobs, busy, generation;
+	SDL_atomic_t next, active;
+	bool quit;
+}
+pool;
+
+static inline void takeJobs(void)
+{
+	for (register int i; (i = SDL_AtomicAdd(&pool.next, 1)) < pool.jobs;)
+		pool.job(pool.data, i);
+}
+
+static int workerMain(void* unused)
+{
+	(void)unused;
+	int seen = 0;
+
+	SDL_LockMutex(pool.lock);
+	for (;;)
+	{
+		while (!pool.quit && pool.generation == seen)
+			SDL_CondWait(pool.wake, pool.lock);
+		if (pool.quit)
+			break;
+		seen = pool.generation;
+		SDL_UnlockMutex(pool.lock);
+
+		takeJobs();
+
+		SDL_LockMutex(pool.lock);
+		if (--pool.busy == 0)
+			SDL_CondSignal(pool.done);
+	}
+	SDL_UnlockMutex(pool.lock);
+	return 0;
+}
+
+static void runJobs(void (*job)(void* data, int index), void* data, int count)
+{
+	// no workers, nothing to share, nested call or pool taken by other thread
+	if (!pool.count || count < 2 || !SDL_AtomicCAS(&pool.active, 0, 1))
+	{
+		for (register int i = 0; i < count; ++i)
+			job(data, i);
+		return;
+	}
+
+	SDL_LockMutex(pool.lock);
+	pool.job = job;
+	pool.data = data;
+	pool.jobs = count;
+	pool.busy = pool.count;
+	SDL_AtomicSet(&pool.next, 0);
+	++pool.generation;
+	SDL_CondBroadcast(pool.wake);
+	SDL_UnlockMutex(pool.lock);
+
+	takeJobs();
+
+	SDL_LockMutex(pool.lock);
+	while (pool.busy)
+		SDL_CondWait(pool.done, pool.lock);
+	SDL_UnlockMutex(pool.lock);
+	SDL_AtomicSet(&pool.active, 0);
+}
+
+// row bands per thread, more bands even out uneven work
+#define BANDS_PER_THREAD (4)
+
+typedef struct
+{
+	SDL_ContextRowsFunc func;
+	void* data;
+	int y1, rows, bands;
+}
+RowBands;
+
+static void runBand(void* data, int index)
+{
+	const RowBands* const b = data;
+	b->func(b->data, b->y1 + (int)((long long)b->rows * index / b->bands), b->y1 + (int)((long long)b->rows * (index + 1) / b->bands));
+}
+
+//
+// Thread pool control
+//
+
+int SDL_ContextStartThreads(int count)
+{
+	if (pool.count)
+		SDL_ContextStopThreads();
+
+	// calling thread works too
+	if (count <= 0)
+		count = SDL_GetCPUCount() - 1;
+	if (count <= 0)
+		return 0;
+
+	pool.lock = SDL_CreateMutex();
+	pool.wake = SDL_CreateCond();
+	pool.done = SDL_CreateCond();
+	if (!pool.lock || !pool.wake || !pool.done)
+	{
+		fprintf(stdout, "SDL_Context(%s): Cannot create thread pool: %s\n", __func__, SDL_GetError());
+		SDL_ContextStopThreads();
+		return 0;
+	}
+
+	pool.threads = xcalloc(count, sizeof(SDL_Thread*));
+	pool.quit = false;
+	pool.generation = 0;
+	for (pool.count = 0; pool.count < count; ++pool.count)
+		if (!(pool.threads[pool.count] = SDL_CreateThread(workerMain, "SDL_ContextWorker", NULL)))
+		{
+			fprintf(stdout, "SDL_Context(%s): Cannot create thread: %s\n", __func__, SDL_GetError());
+			break;
+		}
+
+	// no workers at all, release what was made for them
+	if (!pool.count)
+		SDL_ContextStopThreads();
+	return pool.count;
+}
+
+void SDL_ContextStopThreads(void)
+{
+	if (pool.lock)
+	{
+		SDL_LockMutex(pool.lock);
+		pool.quit = true;
+		SDL_CondBroadcast(pool.wake);
+		SDL_UnlockMutex(pool.lock);
+	}
+
+	for (register int i = 0; i < pool.count; ++i)
+		SDL_WaitThread(pool.threads[i], NULL);
+	xfree(pool.threads);
+	pool.threads = NULL;
+	pool.count = 0;
+
+	if (pool.done) SDL_DestroyCond(pool.done);
+	if (pool.wake) SDL_DestroyCond(pool.wake);
+	if (pool.lock) SDL_DestroyMutex(pool.lock);
+	pool.done = pool.wake = NULL;
+	pool.lock = NULL;
+}
+
+int SDL_ContextGetThreadCount(void)
+{
+	return pool.count;
+}
+
+void SDL_ContextParallelRows(int y1, int y2, int width, SDL_ContextRowsFunc func, void* data)
+{
+	if (y1 >= y2)
+		return;
+
+	// small jobs are not worth waking workers
+	if (!pool.count || (long long)(y2 - y1) * width < SDL_CONTEXT_PARALLEL_PIXELS)
+	{
+		func(data, y1, y2);
+		return;
+	}
+
+	RowBands b = { func, data, y1, y2 - y1, MIN(y2 - y1, (pool.count + 1) * BANDS_PER_THREAD) };
+	runJobs(runBand, &b, b.bands);
+}
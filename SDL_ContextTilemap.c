@@ -0,0 +1,282 @@
+/*
+ * Title: SDL_ContextTilemap.c
+ * Autor: @ooichu
+ * Description: Chunked tilemaps, part of SDL_Context library.
+ * Cells refer to regions of a tile atlas. Square chunks of cells are drawn
+ * once into cached bitmaps, which are redrawn only after one of their cells
+ * changes, and visible chunks are composited a chunk row at a time.
+ * Empty cells are not drawn, dest stays as it is under them.
+ */
+
+// side of a chunk in tiles
+#ifndef SDL_CONTEXT_TILEMAP_CHUNK
+#define SDL_CONTEXT_TILEMAP_CHUNK (16)
+#endif
+
+typedef struct
+{
+	SDL_ContextBitmap* bmp; // NULL until first drawn
+	int tiles;              // non-empty cells
+	bool stale;
+}
+TilemapChunk;
+
+struct SDL_ContextTilemap
+{
+	const SDL_ContextAtlas* tiles;
+	int* cells; // atlas handles, -1 for empty
+	int width, height, tileWidth, tileHeight;
+	TilemapChunk* chunks;
+	int columns, rows; // chunks
+};
+
+SDL_ContextTilemap* SDL_ContextCreateTilemap(const SDL_ContextAtlas* tiles, int width, int height, int tileWidth, int tileHeight)
+{
+	SDL_ContextTilemap* map = xmalloc(sizeof(SDL_ContextTilemap));
+	map->tiles = tiles;
+	map->width = width, map->height = height;
+	map->tileWidth = tileWidth, map->tileHeight = tileHeight;
+	map->columns = (width + SDL_CONTEXT_TILEMAP_CHUNK - 1) / SDL_CONTEXT_TILEMAP_CHUNK;
+	map->rows = (height + SDL_CONTEXT_TILEMAP_CHUNK - 1) / SDL_CONTEXT_TILEMAP_CHUNK;
+	map->chunks = xcalloc(MAX(map->columns * map->rows, 1), sizeof(TilemapChunk));
+	map->cells = xmalloc(MAX(width * height, 1) * sizeof(int));
+	for (register int i = 0; i < width * height; ++i)
+		map->cells[i] = -1;
+	return map;
+}
+
+void SDL_ContextDestroyTilemap(SDL_ContextTilemap* map)
+{
+	if (!map) return;
+	for (register int i = 0; i < map->columns * map->rows; ++i)
+		SDL_ContextDestroyBitmap(map->chunks[i].bmp);
+	xfree(map->chunks);
+	xfree(map->cells);
+	xfree(map);
+}
+
+static inline TilemapChunk* chunkOf(const SDL_ContextTilemap* map, int x, int y)
+{
+	return map->chunks + x / SDL_CONTEXT_TILEMAP_CHUNK + y / SDL_CONTEXT_TILEMAP_CHUNK * map->columns;
+}
+
+void SDL_ContextTilemapSet(SDL_ContextTilemap* map, int x, int y, int tile)
+{
+	if (x < 0 || y < 0 || x >= map->width || y >= map->height)
+		return;
+
+	register int* const cell = map->cells + x + y * map->width;
+	if (*cell == tile)
+		return;
+
+	register TilemapChunk* const chunk = chunkOf(map, x, y);
+	chunk->tiles += (tile >= 0) - (*cell >= 0);
+	chunk->stale = true;
+	*cell = tile;
+}
+
+int SDL_ContextTilemapGet(const SDL_ContextTilemap* map, int x, int y)
+{
+	return (x < 0 || y < 0 || x >= map->width || y >= map->height) ? -1 : map->cells[x + y * map->width];
+}
+
+// cells holds width * height handles in rows
+void SDL_ContextTilemapSetCells(SDL_ContextTilemap* map, const int cells[])
+{
+	for (register int y = 0; y < map->height; ++y)
+		for (register int x = 0; x < map->width; ++x)
+			SDL_ContextTilemapSet(map, x, y, cells[x + y * map->width]);
+}
+
+// redraw every chunk, e.g. after tile images changed
+void SDL_ContextTilemapInvalidate(SDL_ContextTilemap* map)
+{
+	for (register int i = 0; i < map->columns * map->rows; ++i)
+		map->chunks[i].stale = true;
+}
+
+static void renderChunk(const SDL_ContextTilemap* map, TilemapChunk* chunk, int cx, int cy)
+{
+	const int x1 = cx * SDL_CONTEXT_TILEMAP_CHUNK, y1 = cy * SDL_CONTEXT_TILEMAP_CHUNK;
+	const int x2 = MIN(x1 + SDL_CONTEXT_TILEMAP_CHUNK, map->width), y2 = MIN(y1 + SDL_CONTEXT_TILEMAP_CHUNK, map->height);
+
+	if (!chunk->bmp)
+		chunk->bmp = SDL_ContextCreateBitmap((x2 - x1) * map->tileWidth, (y2 - y1) * map->tileHeight);
+	chunk->bmp->premultiplied = SDL_ContextAtlasGetSheet(map->tiles)->premultiplied;
+
+	register const SDL_ContextBitmap* tile;
+	for (register int y = y1; y < y2; ++y)
+		for (register int x = x1; x < x2; ++x)
+			if ((tile = SDL_ContextAtlasGet(map->tiles, map->cells[x + y * map->width])))
+				SDL_ContextBitmapCopy(chunk->bmp, tile, (x - x1) * map->tileWidth, (y - y1) * map->tileHeight);
+			else
+				SDL_ContextBitmapFillRect(chunk->bmp, (x - x1) * map->tileWidth, (y - y1) * map->tileHeight, map->tileWidth, map->tileHeight, 0);
+	chunk->stale = false;
+}
+
+// cells of chunk are all set, whole chunk bitmap is drawn at once
+static inline bool fullChunk(const SDL_ContextTilemap* map, const TilemapChunk* chunk, int cx, int cy)
+{
+	return chunk->tiles == (MIN((cx + 1) * SDL_CONTEXT_TILEMAP_CHUNK, map->width) - cx * SDL_CONTEXT_TILEMAP_CHUNK)
+		* (MIN((cy + 1) * SDL_CONTEXT_TILEMAP_CHUNK, map->height) - cy * SDL_CONTEXT_TILEMAP_CHUNK);
+}
+
+// Next run of set cells of map row y within chunk column cx, starting at
+// cell *x. Its cells are *x..*end - 1, false when there is none.
+static bool nextRun(const SDL_ContextTilemap* map, int cx, int y, int* x, int* end)
+{
+	const int x2 = MIN((cx + 1) * SDL_CONTEXT_TILEMAP_CHUNK, map->width);
+	register const int* const row = map->cells + y * map->width;
+	while (*x < x2 && row[*x] < 0) ++*x;
+	for (*end = *x; *end < x2 && row[*end] >= 0; ++*end);
+	return *x < x2;
+}
+
+// Bring chunks overlapping dest clip up to date and call draw for each row
+// of them with its visible chunks cx1..cx2, x and y is where top left corner
+// of map goes.
+static void visitChunks(SDL_ContextTilemap* map, const SDL_ContextBitmap* dest, int x, int y, void (*draw)(void* data, const SDL_ContextTilemap* map, int x, int y, int cy, int cx1, int cx2), void* data)
+{
+	const int cw = SDL_CONTEXT_TILEMAP_CHUNK * map->tileWidth, ch = SDL_CONTEXT_TILEMAP_CHUNK * map->tileHeight;
+	if (dest->clip.x2 < x || dest->clip.y2 < y)
+		return;
+
+	const int cx1 = MAX(dest->clip.x1 - x, 0) / cw, cy1 = MAX(dest->clip.y1 - y, 0) / ch;
+	const int cx2 = MIN((dest->clip.x2 - x) / cw, map->columns - 1), cy2 = MIN((dest->clip.y2 - y) / ch, map->rows - 1);
+	register TilemapChunk* chunk;
+
+	for (register int cy = cy1; cy <= cy2; ++cy)
+	{
+		for (register int cx = cx1; cx <= cx2; ++cx)
+		{
+			chunk = map->chunks + cx + cy * map->columns;
+			if (chunk->tiles && (chunk->stale || !chunk->bmp))
+				renderChunk(map, chunk, cx, cy);
+		}
+		draw(data, map, x, y, cy, cx1, cx2);
+	}
+}
+
+// Visible non-empty chunks of one chunk row, see copyChunkRow
+typedef struct
+{
+	SDL_ContextBitmap* dest;
+	const SDL_ContextTilemap* map;
+	int x, y, cy, cx1, cx2;
+}
+ChunkRows;
+
+static void chunkRows(void* data, int y1, int y2)
+{
+	const ChunkRows* const job = data;
+	register const SDL_ContextBitmap* const dest = job->dest;
+	register const TilemapChunk* chunk = job->map->chunks + job->cx1 + job->cy * job->map->columns;
+	register const SDL_ContextTilemap* const map = job->map;
+	register const uint32_t* restrict s;
+	register uint32_t* restrict d;
+	const int cw = SDL_CONTEXT_TILEMAP_CHUNK * map->tileWidth, top = job->y + job->cy * SDL_CONTEXT_TILEMAP_CHUNK * map->tileHeight;
+	int left, x1, x2, first, cell, end, a, b;
+	bool full;
+
+	for (register int cx = job->cx1; cx <= job->cx2; ++cx, ++chunk)
+	{
+		if (!chunk->tiles)
+			continue;
+		left = job->x + cx * cw;
+		x1 = MAX(left, dest->clip.x1), x2 = MIN(left + chunk->bmp->width, dest->clip.x2 + 1);
+		if (x1 >= x2)
+			continue;
+		s = chunk->bmp->pixels + (x1 - left) + (y1 - top) * STRIDE(chunk->bmp);
+		d = dest->pixels + x1 + y1 * STRIDE(dest);
+		full = fullChunk(map, chunk, cx, job->cy);
+		first = cx * SDL_CONTEXT_TILEMAP_CHUNK;
+
+		// partly set chunk is drawn a run of set cells at a time
+#define COPY_CHUNK(mode) \
+	for (register int row = y1; row < y2; ++row, s += STRIDE(chunk->bmp), d += STRIDE(dest)) \
+		if (full) \
+			copySpan##mode(d, s, x2 - x1, dest->mask); \
+		else \
+			for (cell = first; nextRun(map, cx, (row - job->y) / map->tileHeight, &cell, &end); cell = end) \
+			{ \
+				a = MAX(left + (cell - first) * map->tileWidth, x1), b = MIN(left + (end - first) * map->tileWidth, x2); \
+				if (a < b) copySpan##mode(d + (a - x1), s + (a - x1), b - a, dest->mask); \
+			}
+		COPY_DISPATCH(dest, chunk->bmp, COPY_CHUNK);
+#undef COPY_CHUNK
+	}
+}
+
+// whole chunk row is one row job, so its chunks are split over the thread pool together
+static void copyChunkRow(void* data, const SDL_ContextTilemap* map, int x, int y, int cy, int cx1, int cx2)
+{
+	register SDL_ContextBitmap* const dest = data;
+	register const TilemapChunk* chunk = map->chunks + cx1 + cy * map->columns;
+	const int cw = SDL_CONTEXT_TILEMAP_CHUNK * map->tileWidth, top = y + cy * SDL_CONTEXT_TILEMAP_CHUNK * map->tileHeight;
+	const int y1 = MAX(top, dest->clip.y1), y2 = MIN(top + MIN(SDL_CONTEXT_TILEMAP_CHUNK, map->height - cy * SDL_CONTEXT_TILEMAP_CHUNK) * map->tileHeight, dest->clip.y2 + 1);
+	int left, x1, x2, width = 0;
+	if (y1 >= y2)
+		return;
+
+	for (register int cx = cx1; cx <= cx2; ++cx, ++chunk)
+	{
+		if (!chunk->tiles)
+			continue;
+		left = x + cx * cw;
+		x1 = MAX(left, dest->clip.x1), x2 = MIN(left + chunk->bmp->width, dest->clip.x2 + 1);
+		if (x1 >= x2)
+			continue;
+		markDirty(dest, x1, y1, x2 - 1, y2 - 1);
+		width += x2 - x1;
+	}
+
+	ChunkRows job = { dest, map, x, y, cy, cx1, cx2 };
+	if (width > 0)
+		SDL_ContextParallelRows(y1, y2, width, chunkRows, &job);
+}
+
+// Partly set chunk is recorded as copies of its runs of set cells, clip of
+// chunk bitmap is kept in each command
+static void recordChunkRow(void* data, const SDL_ContextTilemap* map, int x, int y, int cy, int cx1, int cx2)
+{
+	register const TilemapChunk* chunk = map->chunks + cx1 + cy * map->columns;
+	const int cw = SDL_CONTEXT_TILEMAP_CHUNK * map->tileWidth, ch = SDL_CONTEXT_TILEMAP_CHUNK * map->tileHeight;
+	const int y1 = cy * SDL_CONTEXT_TILEMAP_CHUNK, y2 = MIN(y1 + SDL_CONTEXT_TILEMAP_CHUNK, map->height);
+	int first, cell, end;
+
+	for (register int cx = cx1; cx <= cx2; ++cx, ++chunk)
+	{
+		if (!chunk->tiles)
+			continue;
+		if (fullChunk(map, chunk, cx, cy))
+		{
+			SDL_ContextRecordCopy(data, chunk->bmp, x + cx * cw, y + cy * ch);
+			continue;
+		}
+
+		first = cx * SDL_CONTEXT_TILEMAP_CHUNK;
+		for (register int row = y1; row < y2; ++row)
+			for (cell = first; nextRun(map, cx, row, &cell, &end); cell = end)
+			{
+				const CommandClip run = {
+					(cell - first) * map->tileWidth, (row - y1) * map->tileHeight,
+					(end - first) * map->tileWidth - 1, (row - y1 + 1) * map->tileHeight - 1 };
+				setClip(chunk->bmp, &run);
+				SDL_ContextRecordCopy(data, chunk->bmp, x + cx * cw + run.x1, y + cy * ch + run.y1);
+			}
+		const CommandClip whole = { 0, 0, chunk->bmp->width - 1, chunk->bmp->height - 1 };
+		setClip(chunk->bmp, &whole);
+	}
+}
+
+// Empty cells are skipped, dest under them is left as it is in every blend mode
+void SDL_ContextBitmapDrawTilemap(SDL_ContextBitmap* restrict dest, SDL_ContextTilemap* restrict map, int x, int y)
+{
+	visitChunks(map, dest, x, y, copyChunkRow, dest);
+}
+
+// chunks are redrawn now, cells must not change until commands are flushed
+void SDL_ContextRecordTilemap(SDL_Context* restrict ctx, SDL_ContextTilemap* restrict map, int x, int y)
+{
+	visitChunks(map, ctx->bitmap, x, y, recordChunkRow, ctx);
+}
@@ -158,7 +158,7 @@ private: // game data
 	inline static SDL_Context* ctx = nullptr;
 	inline static bool running = false;
 	inline static State state = State::MENU;
-	inline static SDL_ContextBitmap* font = nullptr;
+	inline static SDL_ContextFont* font = nullptr;
 	inline static unsigned level = 0;
 
 private:
@@ -168,17 +168,11 @@ private:
 public:
 	inline static void addEntity(Entity* const& entity) noexcept { entities.push_back(ptrEntity(entity)); }
 	inline static void addParticle(Entity* const& particle) noexcept { particles.push_back(ptrParticle(particle)); }
-	inline static void drawString(const std::string& str, int x, int y) noexcept
+	inline static void drawString(std::string str, int x, int y) noexcept
 	{
-		for (int i = 0; str[i] != '\0'; ++i)
-		{
-			int c = toupper(str[i]) - '0';
-			if (c >= 0 && c < 43/*symbols*/)
-			{
-				SDL_ContextBitmapClip(font, c * fontWidth, 0, fontWidth - 1, fontHeight - 1);
-				SDL_ContextBitmapCopy(ctx->bitmap, font, x + i * fontWidth, y);
-			}
-		}
+		for (auto& c : str)
+			c = toupper(c);
+		SDL_ContextDrawText(ctx, font, str.c_str(), x, y, (uint32_t)Colors::WHITE);
 	}
 
 public:
@@ -221,11 +215,12 @@ private: // Font (TTF font support not finished :P)
 
 		if (font) return;
 		
-		font = SDL_ContextCreateBitmap(fontWidth * symbols, fontHeight);
+		SDL_ContextBitmap* const sheet = SDL_ContextCreateBitmap(fontWidth * symbols, fontHeight);
 		for (int i = 0; i < symbols; ++i)
 			for (int y = 0; y < fontWidth; ++y)
 				for (int x = 0; x < fontHeight; ++x)
-					SDL_ContextBitmapDrawPoint(font, x + i * fontWidth, y, rawFont[i] & (1 << ((fontWidth - 1 - x) + (fontHeight - 1 - y) * fontWidth)) ? (uint32_t)Colors::WHITE : 0);
+					SDL_ContextBitmapDrawPoint(sheet, x + i * fontWidth, y, rawFont[i] & (1 << ((fontWidth - 1 - x) + (fontHeight - 1 - y) * fontWidth)) ? (uint32_t)Colors::WHITE : 0);
+		font = SDL_ContextCreateFont(sheet, fontWidth, fontHeight, '0');
 	}
 
 public:
@@ -416,7 +411,8 @@ public: // Run / shutdown
 			ctx = nullptr;
 			particles.clear();
 			entities.clear();
-			SDL_ContextDestroyBitmap(font);
+			SDL_ContextDestroyFont(font);
+			font = nullptr;
 		}
 		else
 		{
@@ -25,7 +25,8 @@ static vec_float pos = {WIDTH / 2, HEIGHT / 2, 0};
 static vec_float vel = {0, 0, 0};
 static vec_float acc = {0, 0, 0};
 static float ang = 0.f, angdt = 0, a_cos = 1.f, a_sin = 0.f, spd = 5;
-static SDL_ContextBitmap* bmp;
+static SDL_ContextAtlas* atlas;
+static int ship;
 static const float FRICT = 0.92f;
 
 static void updateTrig(void)
@@ -99,7 +100,6 @@ static void render(SDL_Context* ctx)
 //	SDL_ContextBitmapCopyEx(ctx->bitmap, bmp, 0, 0, 2, 3, SDL_ROTATE_270);
 	//	SDL_ContextDrawBitmap(ctx, bmp, 16, 16, ang * .5f, 8, 8, 1, 1);
 	
-	SDL_ContextBitmapClip(bmp, 16, 0, 15, 15);
 	SDL_ContextDrawLine(ctx, pos.x, pos.y, a_cos * 8 + pos.x, a_sin * 8 + pos.y, SDL_ContextColor(180, 200, 190, 255));
 	SDL_ContextFillCircle(ctx, pos.x, pos.y, 4, SDL_ContextColor(180, 200, 190, 255));
 	
@@ -107,10 +107,10 @@ static void render(SDL_Context* ctx)
 	int mouseY = SDL_ContextGetMouseY(ctx);
 	int mouseWheel = SDL_ContextGetMouseWheel();
 
-	SDL_ContextBitmapCopyEx(SDL_ContextGetFramebuffer(ctx), bmp, 0, 0, 1, 1, 0);
-	SDL_ContextBitmapCopyEx(SDL_ContextGetFramebuffer(ctx), bmp, 0, 16, 1, 1, SDL_ROTATE_90);
-	SDL_ContextBitmapCopyEx(SDL_ContextGetFramebuffer(ctx), bmp, 0, 32, 1, 1, SDL_ROTATE_180);
-	SDL_ContextBitmapCopyEx(SDL_ContextGetFramebuffer(ctx), bmp, 0, 48, 1, 1, SDL_ROTATE_270);
+	SDL_ContextCopyRegionEx(ctx, atlas, ship, 0, 0, 1, 1, 0);
+	SDL_ContextCopyRegionEx(ctx, atlas, ship, 0, 16, 1, 1, SDL_ROTATE_90);
+	SDL_ContextCopyRegionEx(ctx, atlas, ship, 0, 32, 1, 1, SDL_ROTATE_180);
+	SDL_ContextCopyRegionEx(ctx, atlas, ship, 0, 48, 1, 1, SDL_ROTATE_270);
 	SDL_ContextDrawLine(ctx, mouseX - abs(mouseWheel), mouseY, mouseX + abs(mouseWheel), mouseY, SDL_ContextColor(200, 64, 120, 255));
 	SDL_ContextDrawLine(ctx, mouseX, mouseY - abs(mouseWheel), mouseX, mouseY + abs(mouseWheel), SDL_ContextColor(200, 64, 120, 255));
 	
@@ -128,7 +128,13 @@ int main(int argc, char** argv)
 	(void) argv;
 	srand(time(0));
 
-	bmp = SDL_ContextLoadBitmap("assets/testsheet.bmp");
+	if (!(atlas = SDL_ContextCreateAtlas(SDL_ContextLoadBitmap("assets/testsheet.bmp"))))
+		return 1;
+	if ((ship = SDL_ContextAtlasAddRegion(atlas, "ship", 16, 0, 16, 16)) < 0)
+	{
+		SDL_ContextDestroyAtlas(atlas);
+		return 1;
+	}
 
 	SDL_Init(SDL_INIT_EVERYTHING);
 
@@ -146,7 +152,7 @@ int main(int argc, char** argv)
 
 	SDL_ContextMainLoop(ctx, SDL_CONTEXT_DEFAULT_FPS_CAP);
 
-	SDL_ContextDestroyBitmap(bmp);
+	SDL_ContextDestroyAtlas(atlas);
 	
 	SDL_DestroyContext(ctx);
 	